@@ -0,0 +1,228 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ForkServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mozilla {
+namespace startup {
+
+// Largest request we accept, arguments included.
+static const size_t kMaxRequestSize = 64 * 1024;
+
+/**
+ * Take over the inherited connection named by |aArg|, after checking that
+ * it is a Unix SOCK_SEQPACKET socket connected to a process of our own user.
+ *
+ * @return the descriptor, or -1 if |aArg| doesn't name a suitable one.
+ */
+static int
+AdoptConnection(const char* aArg)
+{
+  char* end;
+  errno = 0;
+  long fd = strtol(aArg, &end, 10);
+  if (errno || end == aArg || *end || fd <= STDERR_FILENO || fd > INT32_MAX) {
+    return -1;
+  }
+
+  int value;
+  socklen_t length = sizeof(value);
+  if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &value, &length) ||
+      value != AF_UNIX) {
+    return -1;
+  }
+  length = sizeof(value);
+  if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &value, &length) ||
+      value != SOCK_SEQPACKET) {
+    return -1;
+  }
+  struct ucred peer;
+  length = sizeof(peer);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) ||
+      peer.uid != geteuid()) {
+    return -1;
+  }
+
+  // Keep it out of the content processes we fork and of anything they run.
+  if (fcntl(fd, F_SETFD, FD_CLOEXEC)) {
+    return -1;
+  }
+  return int(fd);
+}
+
+/**
+ * Move the received descriptors to their target numbers. The targets may
+ * collide with the numbers the descriptors arrived as, so everything is
+ * first moved out of the way.
+ */
+static bool
+RemapFds(const int* aFds, const int32_t* aTargets, uint32_t aCount)
+{
+  int moved[ForkRequest::kMaxFds];
+  for (uint32_t i = 0; i < aCount; ++i) {
+    moved[i] = fcntl(aFds[i], F_DUPFD_CLOEXEC, 100);
+    if (moved[i] < 0) {
+      return false;
+    }
+    close(aFds[i]);
+  }
+  for (uint32_t i = 0; i < aCount; ++i) {
+    // dup2 clears FD_CLOEXEC on the new descriptor.
+    if (dup2(moved[i], aTargets[i]) < 0) {
+      return false;
+    }
+    close(moved[i]);
+  }
+  return true;
+}
+
+/**
+ * Read one request.
+ *
+ * @return the number of bytes in |aBuffer|, 0 when the connection is
+ *         closed, or -1 on a malformed request.
+ */
+static ssize_t
+ReceiveRequest(int aConnection, char* aBuffer, int* aFds, uint32_t* aFdCount)
+{
+  struct iovec iov = { aBuffer, kMaxRequestSize };
+  char control[CMSG_SPACE(sizeof(int) * ForkRequest::kMaxFds)];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t size;
+  do {
+    size = recvmsg(aConnection, &msg, MSG_CMSG_CLOEXEC);
+  } while (size < 0 && errno == EINTR);
+  if (size <= 0) {
+    return size < 0 ? 0 : size;
+  }
+
+  *aFdCount = 0;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      uint32_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      memcpy(aFds, CMSG_DATA(cmsg), count * sizeof(int));
+      *aFdCount = count;
+    }
+  }
+
+  if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+      size_t(size) < sizeof(ForkRequest)) {
+    return -1;
+  }
+  return size;
+}
+
+static void
+CloseFds(const int* aFds, uint32_t aCount)
+{
+  for (uint32_t i = 0; i < aCount; ++i) {
+    close(aFds[i]);
+  }
+}
+
+bool
+ForkServer::Run(int& aArgc, char**& aArgv, int* aResult)
+{
+  *aResult = 255;
+  if (aArgc < 3) {
+    fprintf(stderr, "Usage: %s -forkserver <socket descriptor>\n", aArgv[0]);
+    return false;
+  }
+
+  int connection = AdoptConnection(aArgv[2]);
+  if (connection < 0) {
+    fprintf(stderr, "%s is not a connected SOCK_SEQPACKET socket of this user.\n",
+            aArgv[2]);
+    return false;
+  }
+
+  // The children are reparented to us; the browser watches them through
+  // their IPC channels, so there is nothing to collect.
+  signal(SIGCHLD, SIG_IGN);
+
+  char* buffer = static_cast<char*>(malloc(kMaxRequestSize + 1));
+  if (!buffer) {
+    close(connection);
+    return false;
+  }
+
+  for (;;) {
+    int fds[ForkRequest::kMaxFds];
+    uint32_t fdCount = 0;
+    ssize_t size = ReceiveRequest(connection, buffer, fds, &fdCount);
+    if (!size) {
+      break;
+    }
+
+    ForkRequest request;
+    if (size > 0) {
+      memcpy(&request, buffer, sizeof(request));
+    }
+    if (size < 0 || request.mMagic != ForkRequest::kMagic ||
+        request.mFdCount != fdCount || fdCount > ForkRequest::kMaxFds ||
+        !request.mArgc) {
+      CloseFds(fds, fdCount);
+      int32_t reply = -EINVAL;
+      send(connection, &reply, sizeof(reply), MSG_NOSIGNAL);
+      continue;
+    }
+
+    pid_t pid = fork();
+    if (!pid) {
+      // The child: become a content process with the requested arguments.
+      close(connection);
+      signal(SIGCHLD, SIG_DFL);
+      if (!RemapFds(fds, request.mTargetFds, fdCount)) {
+        _exit(255);
+      }
+
+      buffer[size] = '\0';
+      char** argv = static_cast<char**>(
+        calloc(request.mArgc + 2, sizeof(char*)));
+      if (!argv) {
+        _exit(255);
+      }
+      argv[0] = aArgv[0];
+      char* arg = buffer + sizeof(ForkRequest);
+      char* end = buffer + size;
+      int argc = 1;
+      for (uint32_t i = 0; i < request.mArgc && arg < end; ++i) {
+        argv[argc++] = arg;
+        arg += strlen(arg) + 1;
+      }
+      aArgc = argc;
+      aArgv = argv;
+      return true;
+    }
+
+    CloseFds(fds, fdCount);
+    int32_t reply = pid > 0 ? int32_t(pid) : -errno;
+    send(connection, &reply, sizeof(reply), MSG_NOSIGNAL);
+  }
+
+  free(buffer);
+  close(connection);
+  *aResult = 0;
+  return false;
+}
+
+} // namespace startup
+} // namespace mozilla
@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef ForkServer_h__
+#define ForkServer_h__
+
+#include <stdint.h>
+
+namespace mozilla {
+namespace startup {
+
+/**
+ * A pre-initialized zygote for content processes.
+ *
+ * Started as `<app> -forkserver <fd>`, the launcher loads libxul and its
+ * XRE functions once, then serves requests on descriptor <fd>: one end of a
+ * SOCK_SEQPACKET socketpair() that the launching browser created and left
+ * open across the exec. There is no socket in the file system, so no other
+ * process can connect; the server also refuses a descriptor whose peer
+ * belongs to another user. Every request forks a child that continues as
+ * `<app> -contentproc ...` would, but without loading and relocating libxul
+ * again; the children share those pages with the zygote. The server exits
+ * when the browser closes its end.
+ *
+ * A request is one message made of a ForkRequest header followed by
+ * |mArgc| NUL terminated arguments (starting with "-contentproc"), with
+ * |mFdCount| file descriptors attached as SCM_RIGHTS. In the child, the
+ * i-th descriptor is moved to |mTargetFds[i]|, which is how the IPC
+ * channel ends up where the child expects it. The reply is one int32_t:
+ * the pid of the child, or a negated errno value.
+ */
+struct ForkRequest
+{
+  static const uint32_t kMagic = 0x5a79676f; // 'Zygo'
+  static const uint32_t kMaxFds = 8;
+
+  uint32_t mMagic;
+  uint32_t mArgc;
+  uint32_t mFdCount;
+  int32_t mTargetFds[kMaxFds];
+};
+
+class ForkServer
+{
+public:
+  /**
+   * Serve fork requests.
+   *
+   * @return true in a forked child, with |aArgc| and |aArgv| replaced by the
+   *         arguments of the request; false in the server once it is done,
+   *         with |aResult| set to its exit code.
+   */
+  static bool Run(int& aArgc, char**& aArgv, int* aResult);
+};
+
+} // namespace startup
+} // namespace mozilla
+
+#endif // ForkServer_h__
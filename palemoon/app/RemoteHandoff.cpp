@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "RemoteHandoff.h"
+
+#include "mozilla/Sprintf.h"
+#include "nsXPCOMPrivate.h" // for MAXPATHLEN
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace mozilla {
+namespace startup {
+
+// Larger command lines go through the regular remote service.
+static const size_t kMaxMessageSize = 64 * 1024;
+
+// How long we wait for the running instance to handle the command line.
+static const int kReplyTimeoutSec = 10;
+
+/**
+ * Find, and create if needed, the directory holding our socket:
+ * $XDG_RUNTIME_DIR/<app>, or /tmp/<app>-<uid> without it. The directory
+ * must be private to the user, as anyone who can connect may open URLs.
+ */
+static bool
+GetSocketPath(char* aPath, size_t aSize)
+{
+  char dir[MAXPATHLEN];
+  const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+  if (runtimeDir && *runtimeDir == '/') {
+    SprintfLiteral(dir, "%s/%s", runtimeDir, MOZ_APP_NAME);
+  } else {
+    SprintfLiteral(dir, "/tmp/%s-%u", MOZ_APP_NAME, unsigned(getuid()));
+  }
+
+  if (mkdir(dir, 0700) && errno != EEXIST) {
+    return false;
+  }
+
+  struct stat st;
+  if (lstat(dir, &st) || !S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+      (st.st_mode & 077)) {
+    return false;
+  }
+
+  return snprintf(aPath, aSize, "%s/remote", dir) < int(aSize);
+}
+
+static bool
+AppendString(char* aBuffer, size_t* aLength, const char* aString)
+{
+  size_t length = strlen(aString) + 1;
+  if (*aLength + length > kMaxMessageSize) {
+    return false;
+  }
+  memcpy(aBuffer + *aLength, aString, length);
+  *aLength += length;
+  return true;
+}
+
+static bool
+WriteAll(int aFd, const char* aData, size_t aLength)
+{
+  while (aLength) {
+    ssize_t written = send(aFd, aData, aLength, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    aData += written;
+    aLength -= written;
+  }
+  return true;
+}
+
+bool
+RemoteHandoff::Send(int aArgc, char** aArgv, int* aResult)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (!GetSocketPath(addr.sun_path, sizeof(addr.sun_path))) {
+    return false;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+    if (errno == ECONNREFUSED) {
+      // Left behind by an instance that didn't shut down cleanly.
+      unlink(addr.sun_path);
+    }
+    close(fd);
+    // Nobody is listening, so we will.
+    setenv("MOZ_REMOTE_SOCKET", addr.sun_path, 1);
+    return false;
+  }
+
+  char* message = static_cast<char*>(malloc(kMaxMessageSize));
+  size_t length = 0;
+  char cwd[MAXPATHLEN];
+  bool ok = message && getcwd(cwd, sizeof(cwd)) &&
+            AppendString(message, &length, "1") &&
+            AppendString(message, &length, cwd);
+  for (int i = 1; ok && i < aArgc; i++) {
+    ok = AppendString(message, &length, aArgv[i]);
+  }
+  ok = ok && WriteAll(fd, message, length) && !shutdown(fd, SHUT_WR);
+  free(message);
+
+  char reply = 0;
+  if (ok) {
+    struct timeval timeout = { kReplyTimeoutSec, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ssize_t received;
+    do {
+      received = recv(fd, &reply, 1, 0);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The running instance has our command line but is slow to act on
+      // it; starting a second one would only open it twice.
+      fprintf(stderr, "%s: no reply from the running instance, giving up\n",
+              MOZ_APP_NAME);
+      reply = '1';
+    } else if (received != 1) {
+      ok = false;
+    }
+  }
+  close(fd);
+
+  if (!ok) {
+    // The running instance went away; fall back to a regular startup,
+    // which goes through the regular remote service.
+    return false;
+  }
+
+  *aResult = reply == '0' ? 0 : 1;
+  return true;
+}
+
+} // namespace startup
+} // namespace mozilla
@@ -0,0 +1,41 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef RemoteHandoff_h__
+#define RemoteHandoff_h__
+
+namespace mozilla {
+namespace startup {
+
+/**
+ * Hand the command line to an already running instance before libxul is
+ * loaded.
+ *
+ * The first instance started for the default profile listens on a per-user
+ * Unix socket (see palemoon/components/remote). A later launch connects to
+ * it and sends its working directory and arguments, which the running
+ * instance handles like a remote command line. If nothing is listening,
+ * the socket path is exported in MOZ_REMOTE_SOCKET so that this instance
+ * takes over the socket once its UI is up.
+ *
+ * The message is the protocol version ("1"), the working directory and
+ * the arguments (without argv[0]), each NUL terminated. The client then
+ * shuts down its writing side and waits for a one byte reply: '0' if the
+ * command line was handled, '1' if it was rejected.
+ */
+class RemoteHandoff
+{
+public:
+  /**
+   * @return true if a running instance took the command line, in which case
+   *         the launcher should exit with |*aResult|.
+   */
+  static bool Send(int aArgc, char** aArgv, int* aResult);
+};
+
+} // namespace startup
+} // namespace mozilla
+
+#endif // RemoteHandoff_h__
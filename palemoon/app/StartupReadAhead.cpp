@@ -0,0 +1,488 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "StartupReadAhead.h"
+
+#include "mozilla/ArrayUtils.h"
+#include "mozilla/Atomics.h"
+#include "mozilla/Sprintf.h"
+#include "nsXPCOMPrivate.h" // for MAXPATHLEN and XPCOM_DLL
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace mozilla {
+namespace startup {
+
+// How often, and for how long, a recording run samples page residency.
+static const uint32_t kSampleIntervalMs = 10;
+static const uint32_t kRecordTicks = 30 * 1000 / kSampleIntervalMs;
+
+static const char kProfileHeader[] = "startup-readahead 1\n";
+
+// The files we read ahead, relative to the directory of the executable.
+static const char* const kFiles[] = {
+  XPCOM_DLL,
+  "omni.ja",
+  "browser/omni.ja"
+};
+static const size_t kFileCount = ArrayLength(kFiles);
+
+struct TrackedFile
+{
+  char mPath[MAXPATHLEN];
+  int mFd;
+  off_t mSize;
+  time_t mMTime;
+  bool mValid;
+  // Recording only: our own mapping of the file, and for each of its pages
+  // the sample tick in which it was first seen resident (0 for never).
+  void* mMap;
+  uint16_t* mFirstSeen;
+};
+
+static TrackedFile sFiles[kFileCount];
+static char sProfilePath[MAXPATHLEN];
+static FILE* sProfile;
+static bool sLog;
+static bool sReplaying;
+static Atomic<uint32_t> sGlueTimeUs;
+static uint32_t sColdGlueTimeUs;
+
+#define LOG(...)                                  \
+  do {                                            \
+    if (sLog) {                                   \
+      fprintf(stderr, "readahead: " __VA_ARGS__); \
+    }                                             \
+  } while (0)
+
+static uint32_t
+HashString(const char* aString)
+{
+  // FNV-1a; we only need to tell installations apart.
+  uint32_t hash = 2166136261u;
+  for (; *aString; ++aString) {
+    hash = (hash ^ uint8_t(*aString)) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Build the path of the profile for the installation in |aDir|:
+ * $XDG_CACHE_HOME/<app>/startup-readahead-<hash of aDir>. Creates the
+ * directories if |aCreate| is set.
+ */
+static bool
+GetProfilePath(const char* aDir, const char* aAppName, bool aCreate)
+{
+  char cacheDir[MAXPATHLEN];
+  const char* xdgCache = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  if (xdgCache && *xdgCache) {
+    SprintfLiteral(cacheDir, "%s", xdgCache);
+  } else if (home && *home) {
+    SprintfLiteral(cacheDir, "%s/.cache", home);
+  } else {
+    return false;
+  }
+
+  char appDir[MAXPATHLEN];
+  SprintfLiteral(appDir, "%s/%s", cacheDir, aAppName);
+  if (aCreate) {
+    if ((mkdir(cacheDir, 0700) && errno != EEXIST) ||
+        (mkdir(appDir, 0700) && errno != EEXIST)) {
+      return false;
+    }
+  }
+
+  SprintfLiteral(sProfilePath, "%s/startup-readahead-%08x", appDir,
+                 HashString(aDir));
+  return true;
+}
+
+static bool
+OpenFile(TrackedFile& aFile)
+{
+  aFile.mFd = open(aFile.mPath, O_RDONLY | O_CLOEXEC);
+  if (aFile.mFd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(aFile.mFd, &st)) {
+    close(aFile.mFd);
+    aFile.mFd = -1;
+    return false;
+  }
+  aFile.mSize = st.st_size;
+  aFile.mMTime = st.st_mtime;
+  return true;
+}
+
+static void
+CloseFiles()
+{
+  for (TrackedFile& file : sFiles) {
+    if (file.mFd >= 0) {
+      close(file.mFd);
+      file.mFd = -1;
+    }
+  }
+}
+
+static void
+SleepMs(uint32_t aMs)
+{
+  struct timespec ts = { time_t(aMs / 1000), long(aMs % 1000) * 1000000 };
+  while (nanosleep(&ts, &ts) && errno == EINTR) {
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Replay
+
+static void*
+ReplayThread(void*)
+{
+  TimeStamp start = TimeStamp::Now();
+  uint64_t bytes = 0;
+
+  char line[MAXPATHLEN + 64];
+  while (fgets(line, sizeof(line), sProfile)) {
+    unsigned int index;
+    unsigned long long offset, length;
+    if (sscanf(line, "range %u %llu %llu", &index, &offset, &length) != 3 ||
+        index >= kFileCount || !sFiles[index].mValid) {
+      continue;
+    }
+    readahead(sFiles[index].mFd, offset, size_t(length));
+    bytes += length;
+  }
+  fclose(sProfile);
+  sProfile = nullptr;
+  CloseFiles();
+
+  LOG("replayed %llu KB in %.1f ms\n", (unsigned long long)(bytes / 1024),
+      (TimeStamp::Now() - start).ToMilliseconds());
+  return nullptr;
+}
+
+static bool
+StartReplay()
+{
+  sProfile = fopen(sProfilePath, "r");
+  if (!sProfile) {
+    LOG("no profile at %s\n", sProfilePath);
+    return false;
+  }
+
+  char line[MAXPATHLEN + 64];
+  if (!fgets(line, sizeof(line), sProfile) || strcmp(line, kProfileHeader)) {
+    fclose(sProfile);
+    sProfile = nullptr;
+    return false;
+  }
+
+  // The header lines describe the files as they were when recording. Files
+  // that changed since, e.g. after an update, are skipped until the profile
+  // is recorded again.
+  bool anyValid = false;
+  long rangesStart = ftell(sProfile);
+  while (fgets(line, sizeof(line), sProfile)) {
+    unsigned int index;
+    unsigned long long size, mtime;
+    if (sscanf(line, "cold_us %u", &sColdGlueTimeUs) == 1) {
+      rangesStart = ftell(sProfile);
+      continue;
+    }
+    if (sscanf(line, "file %u %llu %llu", &index, &size, &mtime) != 3) {
+      break;
+    }
+    rangesStart = ftell(sProfile);
+    if (index >= kFileCount || !OpenFile(sFiles[index])) {
+      continue;
+    }
+    TrackedFile& file = sFiles[index];
+    file.mValid = uint64_t(file.mSize) == size &&
+                  uint64_t(file.mMTime) == mtime;
+    if (!file.mValid) {
+      LOG("%s changed since the profile was recorded\n", file.mPath);
+    }
+    anyValid |= file.mValid;
+  }
+
+  if (!anyValid || fseek(sProfile, rangesStart, SEEK_SET)) {
+    fclose(sProfile);
+    sProfile = nullptr;
+    CloseFiles();
+    return false;
+  }
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  bool started = !pthread_create(&thread, &attr, ReplayThread, nullptr);
+  pthread_attr_destroy(&attr);
+  if (!started) {
+    fclose(sProfile);
+    sProfile = nullptr;
+    CloseFiles();
+  }
+  return started;
+}
+
+////////////////////////////////////////////////////////////////////////////
+// Recording
+
+struct PageEntry
+{
+  uint16_t mTick;
+  uint8_t mFile;
+  uint32_t mPage;
+};
+
+static int
+ComparePageEntries(const void* aA, const void* aB)
+{
+  const PageEntry* a = static_cast<const PageEntry*>(aA);
+  const PageEntry* b = static_cast<const PageEntry*>(aB);
+  if (a->mTick != b->mTick) {
+    return a->mTick < b->mTick ? -1 : 1;
+  }
+  if (a->mFile != b->mFile) {
+    return a->mFile < b->mFile ? -1 : 1;
+  }
+  return a->mPage < b->mPage ? -1 : (a->mPage > b->mPage ? 1 : 0);
+}
+
+static void
+WriteProfile(long aPageSize)
+{
+  size_t count = 0;
+  for (const TrackedFile& file : sFiles) {
+    if (!file.mFirstSeen) {
+      continue;
+    }
+    size_t pages = (file.mSize + aPageSize - 1) / aPageSize;
+    for (size_t i = 0; i < pages; ++i) {
+      count += file.mFirstSeen[i] ? 1 : 0;
+    }
+  }
+
+  PageEntry* entries =
+    static_cast<PageEntry*>(malloc(sizeof(PageEntry) * (count ? count : 1)));
+  if (!entries) {
+    return;
+  }
+  size_t n = 0;
+  for (size_t f = 0; f < kFileCount; ++f) {
+    const TrackedFile& file = sFiles[f];
+    if (!file.mFirstSeen) {
+      continue;
+    }
+    size_t pages = (file.mSize + aPageSize - 1) / aPageSize;
+    for (size_t i = 0; i < pages; ++i) {
+      if (file.mFirstSeen[i]) {
+        entries[n].mTick = file.mFirstSeen[i];
+        entries[n].mFile = uint8_t(f);
+        entries[n].mPage = uint32_t(i);
+        ++n;
+      }
+    }
+  }
+  qsort(entries, count, sizeof(PageEntry), ComparePageEntries);
+
+  char tmpPath[MAXPATHLEN];
+  SprintfLiteral(tmpPath, "%s.tmp", sProfilePath);
+  FILE* out = fopen(tmpPath, "w");
+  if (!out) {
+    free(entries);
+    return;
+  }
+
+  fputs(kProfileHeader, out);
+  fprintf(out, "cold_us %u\n", uint32_t(sGlueTimeUs));
+  for (size_t f = 0; f < kFileCount; ++f) {
+    const TrackedFile& file = sFiles[f];
+    if (file.mFirstSeen) {
+      fprintf(out, "file %u %llu %llu %s\n", unsigned(f),
+              (unsigned long long)file.mSize,
+              (unsigned long long)file.mMTime, file.mPath);
+    }
+  }
+
+  // Emit the pages in the order they were first seen, merging runs of
+  // consecutive pages of the same file into a single range.
+  size_t ranges = 0;
+  for (size_t i = 0; i < count;) {
+    size_t j = i + 1;
+    while (j < count && entries[j].mFile == entries[i].mFile &&
+           entries[j].mPage == entries[j - 1].mPage + 1) {
+      ++j;
+    }
+    fprintf(out, "range %u %llu %llu\n", unsigned(entries[i].mFile),
+            (unsigned long long)entries[i].mPage * aPageSize,
+            (unsigned long long)(j - i) * aPageSize);
+    ++ranges;
+    i = j;
+  }
+  free(entries);
+
+  bool ok = !ferror(out);
+  ok = !fclose(out) && ok;
+  if (ok && !rename(tmpPath, sProfilePath)) {
+    LOG("recorded %llu KB in %llu ranges to %s\n",
+        (unsigned long long)(count * aPageSize / 1024),
+        (unsigned long long)ranges, sProfilePath);
+  } else {
+    unlink(tmpPath);
+  }
+}
+
+static void*
+RecordThread(void*)
+{
+  long pageSize = sysconf(_SC_PAGESIZE);
+  size_t maxPages = 0;
+  for (const TrackedFile& file : sFiles) {
+    if (file.mFirstSeen) {
+      size_t pages = (file.mSize + pageSize - 1) / pageSize;
+      maxPages = pages > maxPages ? pages : maxPages;
+    }
+  }
+  unsigned char* residency = static_cast<unsigned char*>(malloc(maxPages));
+  if (!residency) {
+    return nullptr;
+  }
+
+  for (uint32_t tick = 1; tick <= kRecordTicks; ++tick) {
+    for (TrackedFile& file : sFiles) {
+      if (!file.mFirstSeen ||
+          mincore(file.mMap, file.mSize, residency)) {
+        continue;
+      }
+      size_t pages = (file.mSize + pageSize - 1) / pageSize;
+      for (size_t i = 0; i < pages; ++i) {
+        if ((residency[i] & 1) && !file.mFirstSeen[i]) {
+          file.mFirstSeen[i] = uint16_t(tick);
+        }
+      }
+    }
+    SleepMs(kSampleIntervalMs);
+  }
+  free(residency);
+
+  WriteProfile(pageSize);
+  return nullptr;
+}
+
+static void
+StartRecording()
+{
+  // Kernels since 5.0 only report page cache residency to users who could
+  // write the file. For system-wide installations the profile comes out
+  // empty, and replaying it does nothing.
+  bool any = false;
+  long pageSize = sysconf(_SC_PAGESIZE);
+  for (TrackedFile& file : sFiles) {
+    if (!OpenFile(file) || !file.mSize) {
+      continue;
+    }
+    // Drop whatever is cached, so that we see the order of a cold start.
+    posix_fadvise(file.mFd, 0, 0, POSIX_FADV_DONTNEED);
+
+    file.mMap = mmap(nullptr, file.mSize, PROT_READ, MAP_SHARED, file.mFd, 0);
+    if (file.mMap == MAP_FAILED) {
+      file.mMap = nullptr;
+      continue;
+    }
+    size_t pages = (file.mSize + pageSize - 1) / pageSize;
+    file.mFirstSeen = static_cast<uint16_t*>(calloc(pages, sizeof(uint16_t)));
+    any |= !!file.mFirstSeen;
+  }
+  if (!any) {
+    return;
+  }
+
+  LOG("recording startup page accesses for %u s\n",
+      kRecordTicks * kSampleIntervalMs / 1000);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_create(&thread, &attr, RecordThread, nullptr);
+  pthread_attr_destroy(&attr);
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+bool
+ReadAhead::Start(const char* aExePath, bool aRecord)
+{
+  sLog = !!getenv("MOZ_READAHEAD_LOG");
+  aRecord |= !!getenv("MOZ_READAHEAD_RECORD");
+  if (!aRecord && getenv("MOZ_READAHEAD_DISABLE")) {
+    return false;
+  }
+
+  char dir[MAXPATHLEN];
+  SprintfLiteral(dir, "%s", aExePath);
+  char* lastSlash = strrchr(dir, '/');
+  if (!lastSlash) {
+    return false;
+  }
+  *lastSlash = '\0';
+
+  // The launcher may be installed as e.g. palemoon-bin.
+  char appName[MAXPATHLEN];
+  SprintfLiteral(appName, "%s", lastSlash + 1);
+  char* suffix = strstr(appName, "-bin");
+  if (suffix) {
+    *suffix = '\0';
+  }
+
+  if (!GetProfilePath(dir, appName, aRecord)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < kFileCount; ++i) {
+    SprintfLiteral(sFiles[i].mPath, "%s/%s", dir, kFiles[i]);
+    sFiles[i].mFd = -1;
+  }
+
+  if (aRecord) {
+    // Preloading all of libxul would hide the order we want to record.
+    StartRecording();
+    return true;
+  }
+
+  sReplaying = StartReplay();
+  return sReplaying;
+}
+
+void
+ReadAhead::GlueLoaded(TimeDuration aDuration)
+{
+  sGlueTimeUs = uint32_t(aDuration.ToMicroseconds());
+  if (sReplaying && sColdGlueTimeUs) {
+    LOG("libxul loaded in %.1f ms, %.1f ms when recorded cold\n",
+        aDuration.ToMilliseconds(), sColdGlueTimeUs / 1000.0);
+  } else {
+    LOG("libxul loaded in %.1f ms\n", aDuration.ToMilliseconds());
+  }
+}
+
+} // namespace startup
+} // namespace mozilla
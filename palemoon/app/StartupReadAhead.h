@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef StartupReadAhead_h__
+#define StartupReadAhead_h__
+
+#include "mozilla/TimeStamp.h"
+
+namespace mozilla {
+namespace startup {
+
+/**
+ * Recorded-order readahead of libxul and the omni.ja archives.
+ *
+ * On slow storage, cold startup is dominated by the random page faults
+ * taken while libxul is relocated and omni.ja is read. A recording run
+ * samples which pages of those files become resident during startup, and
+ * in which order, and stores that as a profile in the user's cache
+ * directory. Later runs replay the profile from a background thread as
+ * sequential readahead() calls, before the main thread needs the pages.
+ *
+ * Recording is requested with the -readahead-record argument or the
+ * MOZ_READAHEAD_RECORD environment variable. MOZ_READAHEAD_DISABLE turns
+ * replay off, and MOZ_READAHEAD_LOG prints timings to stderr.
+ */
+class ReadAhead
+{
+public:
+  /**
+   * Start replaying the stored profile, or, if |aRecord| is set, start
+   * recording a new one.
+   *
+   * @param aExePath
+   *        The full path of the executable; libxul and omni.ja are looked
+   *        up next to it.
+   * @return true if a replay or a recording was started, in which case the
+   *         caller must not preload the whole of libxul.
+   */
+  static bool Start(const char* aExePath, bool aRecord);
+
+  /**
+   * Report how long loading libxul and its XRE functions took. In a
+   * recording run this is stored as the cold baseline, in a replay it is
+   * compared against that baseline.
+   */
+  static void GlueLoaded(TimeDuration aDuration);
+};
+
+} // namespace startup
+} // namespace mozilla
+
+#endif // StartupReadAhead_h__
@@ -0,0 +1,201 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "StartupTrace.h"
+
+#include "mozilla/ArrayUtils.h"
+#include "mozilla/Sprintf.h"
+#include "nsXPCOMPrivate.h" // for MAXPATHLEN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef XP_WIN
+#include <windows.h>
+#define strncasecmp _strnicmp
+#else
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace mozilla {
+namespace startup {
+
+struct TraceEvent
+{
+  const char* mName;
+  TimeStamp mStart;
+  TimeStamp mEnd;   // Null for marks.
+};
+
+static char sPath[MAXPATHLEN];
+static bool sEnabled = false;
+static TraceEvent sEvents[32];
+static size_t sEventCount = 0;
+
+// Wall clock time at sAnchor, to convert TimeStamps.
+static TimeStamp sAnchor;
+static double sAnchorWallUs;
+
+static double
+WallClockMicroseconds()
+{
+#ifdef XP_WIN
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  ULARGE_INTEGER t;
+  t.LowPart = ft.dwLowDateTime;
+  t.HighPart = ft.dwHighDateTime;
+  // 100ns intervals since 1601 to microseconds since 1970.
+  return double(t.QuadPart / 10 - 11644473600000000ULL);
+#else
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return double(tv.tv_sec) * 1000000.0 + double(tv.tv_usec);
+#endif
+}
+
+static double
+ToWallMicroseconds(TimeStamp aTime)
+{
+  return sAnchorWallUs + (aTime - sAnchor).ToMicroseconds();
+}
+
+/**
+ * @return the value of |aArg| if it is "--startup-trace=<value>" or
+ *         "-startup-trace=<value>", an empty string if it is the argument
+ *         without a value, or nullptr if it isn't our argument at all.
+ */
+static const char*
+MatchTraceArg(const char* aArg)
+{
+  static const char kName[] = "startup-trace";
+  if (*aArg != '-') {
+    return nullptr;
+  }
+  if (*++aArg == '-') {
+    ++aArg;
+  }
+  if (strncasecmp(aArg, kName, ArrayLength(kName) - 1)) {
+    return nullptr;
+  }
+  aArg += ArrayLength(kName) - 1;
+  if (*aArg == '=') {
+    return aArg + 1;
+  }
+  return *aArg ? nullptr : "";
+}
+
+void
+StartupTrace::Init(int& aArgc, char** aArgv)
+{
+  for (int i = 1; i < aArgc; i++) {
+    const char* value = MatchTraceArg(aArgv[i]);
+    if (!value) {
+      continue;
+    }
+
+    int consumed = 1;
+    if (!*value && i + 1 < aArgc) {
+      value = aArgv[i + 1];
+      consumed = 2;
+    }
+    if (*value) {
+      SprintfLiteral(sPath, "%s", value);
+      sEnabled = true;
+    }
+
+    for (int j = i; j + consumed <= aArgc; j++) {
+      aArgv[j] = aArgv[j + consumed];
+    }
+    aArgc -= consumed;
+    break;
+  }
+
+  if (!sEnabled) {
+    return;
+  }
+
+  sAnchor = TimeStamp::Now();
+  sAnchorWallUs = WallClockMicroseconds();
+
+  // Let the browser know where to add its own milestones.
+  char env[MAXPATHLEN + 32];
+  SprintfLiteral(env, "MOZ_STARTUP_TRACE=%s", sPath);
+  putenv(strdup(env));
+}
+
+bool
+StartupTrace::IsEnabled()
+{
+  return sEnabled;
+}
+
+void
+StartupTrace::AddPhase(const char* aName, TimeStamp aStart)
+{
+  if (!sEnabled || sEventCount == ArrayLength(sEvents)) {
+    return;
+  }
+  sEvents[sEventCount].mName = aName;
+  sEvents[sEventCount].mStart = aStart;
+  sEvents[sEventCount].mEnd = TimeStamp::Now();
+  ++sEventCount;
+}
+
+void
+StartupTrace::AddMark(const char* aName, TimeStamp aTime)
+{
+  if (!sEnabled || sEventCount == ArrayLength(sEvents)) {
+    return;
+  }
+  sEvents[sEventCount].mName = aName;
+  sEvents[sEventCount].mStart = aTime;
+  sEvents[sEventCount].mEnd = TimeStamp();
+  ++sEventCount;
+}
+
+void
+StartupTrace::Write()
+{
+  if (!sEnabled) {
+    return;
+  }
+
+  FILE* out = fopen(sPath, "w");
+  if (!out) {
+    return;
+  }
+
+#ifdef XP_WIN
+  unsigned long pid = GetCurrentProcessId();
+#else
+  unsigned long pid = getpid();
+#endif
+
+  fputs("[\n", out);
+  for (size_t i = 0; i < sEventCount; ++i) {
+    const TraceEvent& event = sEvents[i];
+    if (event.mEnd.IsNull()) {
+      fprintf(out,
+              "{\"name\":\"%s\",\"cat\":\"launcher\",\"ph\":\"i\","
+              "\"s\":\"p\",\"ts\":%.0f,\"pid\":%lu,\"tid\":0}",
+              event.mName, ToWallMicroseconds(event.mStart), pid);
+    } else {
+      fprintf(out,
+              "{\"name\":\"%s\",\"cat\":\"launcher\",\"ph\":\"X\","
+              "\"ts\":%.0f,\"dur\":%.0f,\"pid\":%lu,\"tid\":0}",
+              event.mName, ToWallMicroseconds(event.mStart),
+              (event.mEnd - event.mStart).ToMicroseconds(), pid);
+    }
+    fputs(i + 1 < sEventCount ? ",\n" : "\n", out);
+  }
+  fputs("]\n", out);
+  fclose(out);
+}
+
+} // namespace startup
+} // namespace mozilla
@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef StartupTrace_h__
+#define StartupTrace_h__
+
+#include "mozilla/Attributes.h"
+#include "mozilla/TimeStamp.h"
+
+namespace mozilla {
+namespace startup {
+
+/**
+ * Chrome trace-event output for the phases of startup.
+ *
+ * Enabled with --startup-trace=<file> (or -startup-trace <file>). The
+ * launcher records its own phases and writes them to <file> as a JSON array
+ * of trace events right before entering XRE_main. It also exports the path
+ * as MOZ_STARTUP_TRACE, so that the browser can add the later startup
+ * timeline milestones to the same file once the session is restored.
+ *
+ * All timestamps are wall clock microseconds, so that events from the
+ * launcher and from the browser share one time base.
+ */
+class StartupTrace
+{
+public:
+  /**
+   * Look for the trace argument, enable tracing if found and remove the
+   * argument so that XRE_main doesn't see it.
+   */
+  static void Init(int& aArgc, char** aArgv);
+
+  static bool IsEnabled();
+
+  /**
+   * Record a phase that ran from |aStart| until now.
+   */
+  static void AddPhase(const char* aName, TimeStamp aStart);
+
+  /**
+   * Record a point in time.
+   */
+  static void AddMark(const char* aName, TimeStamp aTime);
+
+  /**
+   * Write everything recorded so far.
+   */
+  static void Write();
+
+  /**
+   * Records a phase from construction to destruction.
+   */
+  class MOZ_RAII AutoPhase
+  {
+  public:
+    explicit AutoPhase(const char* aName)
+      : mName(aName)
+    {
+      if (StartupTrace::IsEnabled()) {
+        mStart = TimeStamp::Now();
+      }
+    }
+
+    ~AutoPhase()
+    {
+      if (!mStart.IsNull()) {
+        StartupTrace::AddPhase(mName, mStart);
+      }
+    }
+
+  private:
+    const char* mName;
+    TimeStamp mStart;
+  };
+};
+
+} // namespace startup
+} // namespace mozilla
+
+#endif // StartupTrace_h__
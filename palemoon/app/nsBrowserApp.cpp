@@ -35,18 +35,36 @@
 #include "mozilla/Sprintf.h"
 #include "mozilla/WindowsDllBlocklist.h"
 
+#include "StartupTrace.h"
+#ifdef MOZ_STARTUP_READAHEAD
+#include "StartupReadAhead.h"
+#endif
+#ifdef MOZ_REMOTE_HANDOFF
+#include "RemoteHandoff.h"
+#endif
+
 #if !defined(MOZ_WIDGET_COCOA)
 #define MOZ_BROWSER_CAN_BE_CONTENTPROC
 #include "../../ipc/contentproc/plugin-container.cpp"
 #endif
 
+#if defined(MOZ_BROWSER_CAN_BE_CONTENTPROC) && defined(MOZ_CONTENTPROC_FORKSERVER)
+#include "ForkServer.h"
+#endif
+
 using namespace mozilla;
+using mozilla::startup::StartupTrace;
 
 #ifdef XP_MACOSX
 #define kOSXResourcesFolder "Resources"
 #endif
 #define kDesktopFolder "browser"
 
+#ifdef MOZ_STARTUP_READAHEAD
+// Set by -readahead-record to record a new startup readahead profile.
+static bool sRecordReadAhead = false;
+#endif
+
 static void Output(const char *fmt, ... )
 {
   va_list ap;
@@ -107,6 +125,35 @@ static bool IsArg(const char* arg, const char* s)
   return false;
 }
 
+#ifdef MOZ_REMOTE_HANDOFF
+/**
+ * Return true if the command line may be handed to a running instance of
+ * the default profile before XPCOM is started.
+ */
+static bool CanHandOff(int argc, char* argv[])
+{
+  const char* noRemote = getenv("MOZ_NO_REMOTE");
+  if ((noRemote && *noRemote) || getenv("XUL_APP_FILE")) {
+    return false;
+  }
+
+  // Anything that asks for another profile or a separate instance, or that
+  // isn't a browser startup at all.
+  static const char* const kArgs[] = {
+    "app", "headless", "new-instance", "no-remote", "p", "profile",
+    "profilemanager", "safe-mode", "xpcshell"
+  };
+  for (int i = 1; i < argc; i++) {
+    for (const char* arg : kArgs) {
+      if (IsArg(argv[i], arg)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+#endif
+
 XRE_GetFileFromPathType XRE_GetFileFromPath;
 XRE_CreateAppDataType XRE_CreateAppData;
 XRE_FreeAppDataType XRE_FreeAppData;
@@ -200,7 +247,10 @@ static int do_main(int argc, char* argv[], char* envp[], nsIFile *xreDirectory)
 
   if (appini) {
     nsXREAppData *appData;
-    rv = XRE_CreateAppData(appini, &appData);
+    {
+      StartupTrace::AutoPhase phase("XRE_CreateAppData");
+      rv = XRE_CreateAppData(appini, &appData);
+    }
     if (NS_FAILED(rv)) {
       Output("Couldn't read application.ini");
       return 255;
@@ -214,6 +264,8 @@ static int do_main(int argc, char* argv[], char* envp[], nsIFile *xreDirectory)
 #endif
     // xreDirectory already has a refcount from NS_NewLocalFile
     appData->xreDirectory = xreDirectory;
+    StartupTrace::AddMark("XRE_main", TimeStamp::Now());
+    StartupTrace::Write();
     int result = XRE_main(argc, argv, appData, mainFlags);
     XRE_FreeAppData(appData);
     return result;
@@ -221,7 +273,10 @@ static int do_main(int argc, char* argv[], char* envp[], nsIFile *xreDirectory)
 
   ScopedAppData appData(&sAppData);
   nsCOMPtr<nsIFile> exeFile;
-  rv = mozilla::BinaryPath::GetFile(argv[0], getter_AddRefs(exeFile));
+  {
+    StartupTrace::AutoPhase phase("BinaryPath::GetFile");
+    rv = mozilla::BinaryPath::GetFile(argv[0], getter_AddRefs(exeFile));
+  }
   if (NS_FAILED(rv)) {
     Output("Couldn't find the application directory.\n");
     return 255;
@@ -250,6 +305,8 @@ static int do_main(int argc, char* argv[], char* envp[], nsIFile *xreDirectory)
     XRE_LibFuzzerSetMain(argc, argv, libfuzzer_main);
 #endif
 
+  StartupTrace::AddMark("XRE_main", TimeStamp::Now());
+  StartupTrace::Write();
   return XRE_main(argc, argv, &appData, mainFlags);
 }
 
@@ -271,7 +328,11 @@ InitXPCOMGlue(const char *argv0, nsIFile **xreDirectory)
 {
   char exePath[MAXPATHLEN];
 
-  nsresult rv = mozilla::BinaryPath::Get(argv0, exePath);
+  nsresult rv;
+  {
+    StartupTrace::AutoPhase phase("BinaryPath::Get");
+    rv = mozilla::BinaryPath::Get(argv0, exePath);
+  }
   if (NS_FAILED(rv)) {
     Output("Couldn't find the application directory.\n");
     return rv;
@@ -282,6 +343,17 @@ InitXPCOMGlue(const char *argv0, nsIFile **xreDirectory)
       (size_t(lastSlash - exePath) > MAXPATHLEN - sizeof(XPCOM_DLL) - 1))
     return NS_ERROR_FAILURE;
 
+#ifdef MOZ_STARTUP_READAHEAD
+  // Start reading ahead as early as possible. Only the main process does
+  // this; content processes find the pages already cached.
+  bool readingAhead = false;
+  if (xreDirectory) {
+    readingAhead = mozilla::startup::ReadAhead::Start(exePath,
+                                                      sRecordReadAhead);
+  }
+  TimeStamp glueStart = TimeStamp::Now();
+#endif
+
   strcpy(lastSlash + 1, XPCOM_DLL);
 
   if (!FileExists(exePath)) {
@@ -289,21 +361,36 @@ InitXPCOMGlue(const char *argv0, nsIFile **xreDirectory)
     return NS_ERROR_FAILURE;
   }
 
+#ifdef MOZ_STARTUP_READAHEAD
+  if (!readingAhead)
+#endif
   // We do this because of data in bug 771745
   XPCOMGlueEnablePreload();
 
-  rv = XPCOMGlueStartup(exePath);
+  {
+    StartupTrace::AutoPhase phase("XPCOMGlueStartup");
+    rv = XPCOMGlueStartup(exePath);
+  }
   if (NS_FAILED(rv)) {
     Output("Couldn't load XPCOM.\n");
     return rv;
   }
 
-  rv = XPCOMGlueLoadXULFunctions(kXULFuncs);
+  {
+    StartupTrace::AutoPhase phase("XPCOMGlueLoadXULFunctions");
+    rv = XPCOMGlueLoadXULFunctions(kXULFuncs);
+  }
   if (NS_FAILED(rv)) {
     Output("Couldn't load XRE functions.\n");
     return rv;
   }
 
+#ifdef MOZ_STARTUP_READAHEAD
+  if (xreDirectory) {
+    mozilla::startup::ReadAhead::GlueLoaded(TimeStamp::Now() - glueStart);
+  }
+#endif
+
   // This will set this thread as the main thread.
   NS_LogInit();
 
@@ -358,11 +445,73 @@ int main(int argc, char* argv[], char* envp[])
 
     return result;
   }
+
+#ifdef MOZ_CONTENTPROC_FORKSERVER
+  // We are launching as a zygote for content processes: load libxul once,
+  // then fork pre-linked content processes on request.
+  if (argc > 1 && IsArg(argv[1], "forkserver")) {
+    nsresult rv = InitXPCOMGlue(argv[0], nullptr);
+    if (NS_FAILED(rv)) {
+      return 255;
+    }
+
+    int result;
+    if (mozilla::startup::ForkServer::Run(argc, argv, &result)) {
+      // Only forked children get here, with their -contentproc arguments.
+      result = content_process_main(argc, argv);
+    }
+
+    NS_LogTerm();
+
+    return result;
+  }
+#endif
 #endif
 
 
   nsIFile *xreDirectory;
 
+#ifdef MOZ_STARTUP_READAHEAD
+  for (int i = 1; i < argc; i++) {
+    if (IsArg(argv[i], "readahead-record")) {
+      sRecordReadAhead = true;
+      // Don't pass it on to XRE_main.
+      for (int j = i; j < argc; j++) {
+        argv[j] = argv[j + 1];
+      }
+      --argc;
+      break;
+    }
+  }
+#endif
+
+  StartupTrace::Init(argc, argv);
+  StartupTrace::AddMark("launcher", start);
+
+  // A -benchmark run must not be forwarded to an instance that is already
+  // running, neither here nor by the remote service.
+  for (int i = 1; i < argc; i++) {
+    if (IsArg(argv[i], "benchmark")) {
+      putenv(const_cast<char*>("MOZ_NO_REMOTE=1"));
+      break;
+    }
+  }
+
+#ifdef MOZ_REMOTE_HANDOFF
+  // Let an already running instance open our URLs without loading libxul.
+  // Startups that are being measured are never handed off.
+  if (!StartupTrace::IsEnabled() &&
+#ifdef MOZ_STARTUP_READAHEAD
+      !sRecordReadAhead &&
+#endif
+      CanHandOff(argc, argv)) {
+    int result;
+    if (mozilla::startup::RemoteHandoff::Send(argc, argv, &result)) {
+      return result;
+    }
+  }
+#endif
+
   nsresult rv = InitXPCOMGlue(argv[0], &xreDirectory);
   if (NS_FAILED(rv)) {
     return 255;
@@ -852,11 +852,24 @@ pref("browser.rights.3.shown", false);
 pref("browser.rights.override", true);
 #endif
 
+// Linux only: exit as soon as the profile has been saved at shutdown,
+// skipping the XPCOM teardown. Run with MOZ_FAST_SHUTDOWN_CHECK=<file> to log
+// any file the regular shutdown still writes after that point to <file>.
+pref("browser.shutdown.fast", false);
+
 pref("browser.sessionstore.resume_from_crash", true);
 pref("browser.sessionstore.resume_session_once", false);
 
 // minimal interval between two save operations in milliseconds
 pref("browser.sessionstore.interval",60000);
+// append the changes since the last save to a journal instead of rewriting
+// the whole session every interval
+pref("browser.sessionstore.journal.enabled", true);
+// maximal time between two full writes of the session (in ms)
+pref("browser.sessionstore.journal.checkpoint_interval", 600000);
+// compress the session file and its backup with LZ4, as sessionstore.jsonlz4
+// and sessionstore.baklz4 (both formats are read)
+pref("browser.sessionstore.compress", true);
 // maximum amount of POSTDATA to be saved in bytes per history entry (-1 = all of it)
 // (NB: POSTDATA will be saved either entirely or not at all)
 pref("browser.sessionstore.postdata", 0);
@@ -886,6 +899,12 @@ pref("browser.sessionstore.restore_on_demand", true);
 // The number of tabs that can restore concurrently.
 // Sane values are 1..10, default 3.
 pref("browser.sessionstore.max_concurrent_tabs", 3);
+// Adapt the number of tabs restoring concurrently to how fast they load and
+// how busy the CPU is, starting from max_concurrent_tabs.
+pref("browser.sessionstore.adaptive_restore.enabled", true);
+// The most tabs the adaptive restore may load at once, 0 for twice the
+// number of CPU cores. Sane values are 1..10.
+pref("browser.sessionstore.adaptive_restore.max_concurrent_tabs", 0);
 // Whether to automatically restore hidden tabs (i.e., tabs in other tab groups) or not
 pref("browser.sessionstore.restore_hidden_tabs", false);
 // If restore_on_demand is set, pinned tabs are restored on startup by default.
@@ -1158,6 +1177,41 @@ pref("toolkit.startup.max_resumed_crashes", 3);
 // (This is intentionally on the high side; see bug 746055.)
 pref("image.mem.max_decoded_image_kb", 256000);
 
+// Memory tiers: at startup, the amount of memory we may use (physical memory,
+// capped by the cgroup limit on Linux) picks one of the tiers below, whose
+// prefs then become the defaults for the pref of the same name. Prefs the
+// user has set keep their value. A low-memory notification may drop us to a
+// lower tier for the rest of the session.
+pref("browser.memorytier.enabled", true);
+// Force a tier ("low", "medium" or "high") instead of detecting one.
+pref("browser.memorytier.override", "");
+// Below this many MB we use the low tier, then the medium tier.
+pref("browser.memorytier.low_max_mb", 1024);
+pref("browser.memorytier.medium_max_mb", 2560);
+
+pref("browser.memorytier.low.browser.cache.memory.capacity", 8192);
+pref("browser.memorytier.low.browser.sessionhistory.max_entries", 10);
+pref("browser.memorytier.low.browser.sessionhistory.max_total_viewers", 0);
+pref("browser.memorytier.low.browser.sessionstore.interval", 120000);
+pref("browser.memorytier.low.browser.sessionstore.max_concurrent_tabs", 1);
+pref("browser.memorytier.low.browser.sessionstore.adaptive_restore.max_concurrent_tabs", 2);
+pref("browser.memorytier.low.image.mem.max_decoded_image_kb", 32768);
+
+pref("browser.memorytier.medium.browser.cache.memory.capacity", 32768);
+pref("browser.memorytier.medium.browser.sessionhistory.max_entries", 25);
+pref("browser.memorytier.medium.browser.sessionhistory.max_total_viewers", 2);
+pref("browser.memorytier.medium.browser.sessionstore.interval", 90000);
+pref("browser.memorytier.medium.browser.sessionstore.max_concurrent_tabs", 2);
+pref("browser.memorytier.medium.browser.sessionstore.adaptive_restore.max_concurrent_tabs", 4);
+pref("browser.memorytier.medium.image.mem.max_decoded_image_kb", 98304);
+
+pref("browser.memorytier.high.browser.cache.memory.capacity", -1);
+pref("browser.memorytier.high.browser.sessionhistory.max_entries", 50);
+pref("browser.memorytier.high.browser.sessionhistory.max_total_viewers", -1);
+pref("browser.memorytier.high.browser.sessionstore.interval", 60000);
+pref("browser.memorytier.high.browser.sessionstore.max_concurrent_tabs", 3);
+pref("browser.memorytier.high.image.mem.max_decoded_image_kb", 256000);
+
 // Turn on the CSP 1.0 parser for Content Security Policy headers
 pref("security.csp.speccompliant", true);
 
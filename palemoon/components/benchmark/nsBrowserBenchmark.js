@@ -0,0 +1,349 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * -benchmark commandline handler
+ *
+ * Loads every page of a URL list a number of times from a built-in local
+ * file server and reports time to first paint, load event time, peak RSS
+ * and CPU time per load as JSON, then quits. Requests to any other host
+ * are cancelled, so runs are reproducible and work offline.
+ */
+
+const Cc = Components.classes;
+const Ci = Components.interfaces;
+const Cr = Components.results;
+const Cu = Components.utils;
+
+Cu.import("resource://gre/modules/XPCOMUtils.jsm");
+Cu.import("resource://gre/modules/Services.jsm");
+
+XPCOMUtils.defineLazyModuleGetter(this, "BenchmarkServer",
+                                  "resource:///modules/BenchmarkServer.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "OS",
+                                  "resource://gre/modules/osfile.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "Task",
+                                  "resource://gre/modules/Task.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "setTimeout",
+                                  "resource://gre/modules/Timer.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "ctypes",
+                                  "resource://gre/modules/ctypes.jsm");
+
+const BENCHMARK_WINDOW_URL = "chrome://browser/content/benchmark/benchmark.xul";
+
+const DEFAULT_RUNS = 5;
+
+// Give up on a page that hasn't fired its load event after this long.
+const LOAD_TIMEOUT_MS = 60 * 1000;
+
+// How long to wait for a first paint after the load event.
+const PAINT_TIMEOUT_MS = 1000;
+
+// How often we sample the resident set size during a load.
+const RSS_SAMPLE_MS = 20;
+
+XPCOMUtils.defineLazyGetter(this, "gMemoryReporterManager", function() {
+  return Cc["@mozilla.org/memory-reporter-manager;1"].
+         getService(Ci.nsIMemoryReporterManager);
+});
+
+/**
+ * @return the CPU time used by the process so far in milliseconds, or null
+ *         where we can't tell.
+ */
+XPCOMUtils.defineLazyGetter(this, "getCPUTime", function() {
+  let clock = null;
+  if (OS.Constants.Path.libc) {
+    try {
+      let libc = ctypes.open(OS.Constants.Path.libc);
+      clock = libc.declare("clock", ctypes.default_abi, ctypes.long);
+    } catch (ex) {}
+  }
+  // POSIX requires CLOCKS_PER_SEC to be one million.
+  return () => clock ? clock() / 1000 : null;
+});
+
+function getResident() {
+  try {
+    return gMemoryReporterManager.resident;
+  } catch (ex) {
+    return null;
+  }
+}
+
+function median(aValues) {
+  let values = aValues.filter(v => v !== null).sort((a, b) => a - b);
+  if (!values.length) {
+    return null;
+  }
+  let middle = values.length >> 1;
+  return values.length % 2 ? values[middle] :
+                             (values[middle - 1] + values[middle]) / 2;
+}
+
+function clearCaches() {
+  Services.cache2.clear();
+  try {
+    Cc["@mozilla.org/image/tools;1"].getService(Ci.imgITools)
+                                    .getImgCacheForDocument(null)
+                                    .clearCache(false);
+  } catch (ex) {}
+}
+
+/**
+ * Cancels every HTTP request that isn't for our server.
+ */
+function OfflineGuard(aPort) {
+  this._hostPort = "127.0.0.1:" + aPort;
+  this.blocked = 0;
+  Services.obs.addObserver(this, "http-on-modify-request", false);
+}
+
+OfflineGuard.prototype = {
+  observe: function(aSubject, aTopic, aData) {
+    let channel = aSubject.QueryInterface(Ci.nsIChannel);
+    if (channel.URI.hostPort != this._hostPort) {
+      channel.cancel(Cr.NS_ERROR_ABORT);
+      this.blocked++;
+    }
+  },
+
+  stop: function() {
+    Services.obs.removeObserver(this, "http-on-modify-request");
+  },
+};
+
+function openBenchmarkWindow() {
+  return new Promise(resolve => {
+    let win = Services.ww.openWindow(null, BENCHMARK_WINDOW_URL, "_blank",
+                                     "chrome,dialog=no,all", null);
+    win.addEventListener("load", function onLoad() {
+      win.removeEventListener("load", onLoad);
+      resolve(win);
+    });
+  });
+}
+
+/**
+ * Load |aURL| into |aBrowser|.
+ *
+ * @return a promise for whether the load event fired in time.
+ */
+function loadPage(aBrowser, aURL) {
+  return new Promise(resolve => {
+    let done = false;
+    let onLoad = event => {
+      if (event.target == aBrowser.contentDocument &&
+          aBrowser.contentDocument.documentURI == aURL) {
+        finish(true);
+      }
+    };
+    let finish = loaded => {
+      if (!done) {
+        done = true;
+        aBrowser.removeEventListener("load", onLoad, true);
+        resolve(loaded);
+      }
+    };
+    aBrowser.addEventListener("load", onLoad, true);
+    setTimeout(() => finish(false), LOAD_TIMEOUT_MS);
+    aBrowser.loadURI(aURL);
+  });
+}
+
+/**
+ * Load |aURL| once and measure it.
+ */
+function* measureLoad(aBrowser, aURL) {
+  let firstPaint = null;
+  let onPaint = () => {
+    if (firstPaint === null &&
+        aBrowser.contentDocument.documentURI == aURL) {
+      // Relative to the navigation start of the new document.
+      firstPaint = aBrowser.contentWindow.performance.now();
+    }
+  };
+  aBrowser.addEventListener("MozAfterPaint", onPaint);
+
+  let peakRSS = getResident();
+  let sampling = true;
+  let sample = () => {
+    let resident = getResident();
+    if (resident !== null && resident > peakRSS) {
+      peakRSS = resident;
+    }
+    if (sampling) {
+      setTimeout(sample, RSS_SAMPLE_MS);
+    }
+  };
+  sample();
+
+  let cpuStart = getCPUTime();
+  let loaded = yield loadPage(aBrowser, aURL);
+  for (let waited = 0; loaded && firstPaint === null &&
+                       waited < PAINT_TIMEOUT_MS; waited += RSS_SAMPLE_MS) {
+    yield new Promise(resolve => setTimeout(resolve, RSS_SAMPLE_MS));
+  }
+  let cpuEnd = getCPUTime();
+
+  sampling = false;
+  sample();
+  aBrowser.removeEventListener("MozAfterPaint", onPaint);
+
+  if (!loaded) {
+    return { error: "timeout" };
+  }
+
+  let timing = aBrowser.contentWindow.performance.timing;
+  return {
+    firstPaint: firstPaint === null ? null : Math.round(firstPaint),
+    domContentLoaded: timing.domContentLoadedEventStart -
+                      timing.navigationStart,
+    loadEvent: timing.loadEventStart - timing.navigationStart,
+    peakRSS: peakRSS,
+    cpuTime: cpuStart === null ? null : Math.round(cpuEnd - cpuStart),
+  };
+}
+
+function* runBenchmark(aOptions) {
+  let list = yield OS.File.read(aOptions.list.path, { encoding: "utf-8" });
+  let paths = list.split(/\r?\n/).map(line => line.trim())
+                  .filter(line => line && line[0] != "#");
+  if (!paths.length) {
+    throw new Error("No pages to load in " + aOptions.list.path);
+  }
+
+  let server = new BenchmarkServer(aOptions.root);
+  server.start();
+  let guard = new OfflineGuard(server.port);
+  let base = "http://127.0.0.1:" + server.port + "/";
+
+  let results = [];
+  try {
+    let win = yield openBenchmarkWindow();
+    let browser = win.document.getElementById("content");
+
+    for (let path of paths) {
+      let url = base + path.replace(/^\/+/, "");
+      guard.blocked = 0;
+      if (aOptions.cache == "warm") {
+        // Unmeasured load to fill the caches.
+        yield loadPage(browser, url);
+      }
+
+      let loads = [];
+      for (let i = 0; i < aOptions.runs; i++) {
+        yield loadPage(browser, "about:blank");
+        if (aOptions.cache == "cold") {
+          clearCaches();
+        }
+        Cu.forceGC();
+        Cu.forceCC();
+        loads.push(yield Task.spawn(() => measureLoad(browser, url)));
+      }
+
+      let summary = {};
+      for (let key of ["firstPaint", "domContentLoaded", "loadEvent",
+                       "peakRSS", "cpuTime"]) {
+        summary[key] = median(loads.map(load => key in load ? load[key] : null));
+      }
+      results.push({ url: path, loads: loads, median: summary,
+                     blockedRequests: guard.blocked });
+    }
+
+    win.close();
+  } finally {
+    guard.stop();
+    server.stop();
+  }
+
+  let report = JSON.stringify({
+    application: Services.appinfo.name + " " + Services.appinfo.version,
+    buildID: Services.appinfo.appBuildID,
+    runs: aOptions.runs,
+    cache: aOptions.cache,
+    results: results,
+  }, null, 2) + "\n";
+
+  if (aOptions.output) {
+    yield OS.File.writeAtomic(aOptions.output.path, report,
+                              { encoding: "utf-8",
+                                tmpPath: aOptions.output.path + ".tmp" });
+  } else {
+    dump(report);
+  }
+}
+
+function nsBrowserBenchmark() {}
+
+nsBrowserBenchmark.prototype = {
+  handle: function(aCmdLine) {
+    let list = aCmdLine.handleFlagWithParam("benchmark", false);
+    if (!list) {
+      return;
+    }
+    if (aCmdLine.state != Ci.nsICommandLine.STATE_INITIAL_LAUNCH) {
+      throw Cr.NS_ERROR_ABORT;
+    }
+
+    // Don't open a browser window or restore the session.
+    aCmdLine.preventDefault = true;
+
+    let options = {
+      list: aCmdLine.resolveFile(list),
+      root: null,
+      runs: DEFAULT_RUNS,
+      cache: "cold",
+      output: null,
+    };
+
+    let root = aCmdLine.handleFlagWithParam("benchmark-root", false);
+    let runs = aCmdLine.handleFlagWithParam("benchmark-runs", false);
+    let cache = aCmdLine.handleFlagWithParam("benchmark-cache", false);
+    let output = aCmdLine.handleFlagWithParam("benchmark-output", false);
+    if (root) {
+      options.root = aCmdLine.resolveFile(root);
+    }
+    if (runs) {
+      options.runs = parseInt(runs, 10);
+    }
+    if (cache) {
+      options.cache = cache;
+    }
+    if (output) {
+      options.output = aCmdLine.resolveFile(output);
+    }
+
+    if (!options.root || !options.root.isDirectory() ||
+        !(options.runs > 0) ||
+        (options.cache != "cold" && options.cache != "warm")) {
+      dump("Usage: -benchmark <url list> -benchmark-root <dir> " +
+           "[-benchmark-runs <n>] [-benchmark-cache cold|warm] " +
+           "[-benchmark-output <file>]\n");
+      throw Cr.NS_ERROR_ABORT;
+    }
+
+    // Keep running until we are done, whatever windows come and go.
+    Services.startup.enterLastWindowClosingSurvivalArea();
+    Task.spawn(() => runBenchmark(options)).then(null, ex => {
+      dump("Benchmark failed: " + ex + "\n");
+      Cu.reportError(ex);
+    }).then(() => {
+      Services.startup.exitLastWindowClosingSurvivalArea();
+      Services.startup.quit(Ci.nsIAppStartup.eForceQuit);
+    });
+  },
+
+  helpInfo: "  --benchmark <file>                          Load the pages listed in <file> from\n" +
+            "                                              --benchmark-root <dir> and report their\n" +
+            "                                              timings as JSON, then quit. Also takes\n" +
+            "                                              --benchmark-runs <n>,\n" +
+            "                                              --benchmark-cache cold|warm and\n" +
+            "                                              --benchmark-output <file>.\n",
+
+  classID: Components.ID("{a6afc04e-f73d-46b9-b44e-ce8d7d711180}"),
+  QueryInterface: XPCOMUtils.generateQI([Ci.nsICommandLineHandler]),
+};
+
+this.NSGetFactory = XPCOMUtils.generateNSGetFactory([nsBrowserBenchmark]);
@@ -26,6 +26,20 @@
 #define NS_PRIVATE_BROWSING_SERVICE_WRAPPER_CID \
 { 0x136e2c4d, 0xc5a4, 0x477c, { 0xb1, 0x31, 0xd9, 0x3d, 0x7d, 0x70, 0x4f, 0x64 } }
 
+// {91ab6945-9ce9-43e9-9bb2-4a1947864783}
+#define NS_REMOTEHANDOFFSERVICE_CID \
+{ 0x91ab6945, 0x9ce9, 0x43e9, { 0x9b, 0xb2, 0x4a, 0x19, 0x47, 0x86, 0x47, 0x83 } }
+
+#define NS_REMOTEHANDOFFSERVICE_CONTRACTID \
+  "@mozilla.org/browser/remote-handoff-service;1"
+
+// {ec9034f5-4327-43d6-8bee-07ccf6f73e38}
+#define NS_FASTSHUTDOWN_CID \
+{ 0xec9034f5, 0x4327, 0x43d6, { 0x8b, 0xee, 0x07, 0xcc, 0xf6, 0xf7, 0x3e, 0x38 } }
+
+#define NS_FASTSHUTDOWN_CONTRACTID \
+  "@mozilla.org/browser/fast-shutdown;1"
+
 // {6DEB193C-F87D-4078-BC78-5E64655B4D62}
 #define NS_BROWSERDIRECTORYPROVIDER_CID \
 { 0x6deb193c, 0xf87d, 0x4078, { 0xbc, 0x78, 0x5e, 0x64, 0x65, 0x5b, 0x4d, 0x62 } }
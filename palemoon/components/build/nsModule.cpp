@@ -14,6 +14,11 @@
 #include "nsMacShellService.h"
 #elif defined(MOZ_WIDGET_GTK)
 #include "nsGNOMEShellService.h"
+#include "nsRemoteHandoffService.h"
+#endif
+
+#if defined(XP_LINUX)
+#include "nsFastShutdown.h"
 #endif
 
 #include "rdf.h"
@@ -31,18 +36,27 @@ NS_GENERIC_FACTORY_CONSTRUCTOR(nsWindowsShellService)
 #elif defined(XP_MACOSX)
 NS_GENERIC_FACTORY_CONSTRUCTOR(nsMacShellService)
 #elif defined(MOZ_WIDGET_GTK)
-NS_GENERIC_FACTORY_CONSTRUCTOR_INIT(nsGNOMEShellService, Init)
+NS_GENERIC_FACTORY_CONSTRUCTOR(nsGNOMEShellServiceProxy)
+NS_GENERIC_FACTORY_CONSTRUCTOR(nsRemoteHandoffService)
 #endif
 
 NS_GENERIC_FACTORY_CONSTRUCTOR(nsFeedSniffer)
 
+#if defined(XP_LINUX)
+NS_GENERIC_FACTORY_CONSTRUCTOR(nsFastShutdown)
+#endif
+
 NS_DEFINE_NAMED_CID(NS_BROWSERDIRECTORYPROVIDER_CID);
 #if defined(XP_WIN)
 NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
 #elif defined(MOZ_WIDGET_GTK)
 NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
+NS_DEFINE_NAMED_CID(NS_REMOTEHANDOFFSERVICE_CID);
 #endif
 NS_DEFINE_NAMED_CID(NS_FEEDSNIFFER_CID);
+#if defined(XP_LINUX)
+NS_DEFINE_NAMED_CID(NS_FASTSHUTDOWN_CID);
+#endif
 #ifdef XP_MACOSX
 NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
 #endif
@@ -52,9 +66,13 @@ static const mozilla::Module::CIDEntry kBrowserCIDs[] = {
 #if defined(XP_WIN)
     { &kNS_SHELLSERVICE_CID, false, nullptr, nsWindowsShellServiceConstructor },
 #elif defined(MOZ_WIDGET_GTK)
-    { &kNS_SHELLSERVICE_CID, false, nullptr, nsGNOMEShellServiceConstructor },
+    { &kNS_SHELLSERVICE_CID, false, nullptr, nsGNOMEShellServiceProxyConstructor },
+    { &kNS_REMOTEHANDOFFSERVICE_CID, false, nullptr, nsRemoteHandoffServiceConstructor },
 #endif
     { &kNS_FEEDSNIFFER_CID, false, nullptr, nsFeedSnifferConstructor },
+#if defined(XP_LINUX)
+    { &kNS_FASTSHUTDOWN_CID, false, nullptr, nsFastShutdownConstructor },
+#endif
 #ifdef XP_MACOSX
     { &kNS_SHELLSERVICE_CID, false, nullptr, nsMacShellServiceConstructor },
 #endif
@@ -67,8 +85,12 @@ static const mozilla::Module::ContractIDEntry kBrowserContracts[] = {
     { NS_SHELLSERVICE_CONTRACTID, &kNS_SHELLSERVICE_CID },
 #elif defined(MOZ_WIDGET_GTK)
     { NS_SHELLSERVICE_CONTRACTID, &kNS_SHELLSERVICE_CID },
+    { NS_REMOTEHANDOFFSERVICE_CONTRACTID, &kNS_REMOTEHANDOFFSERVICE_CID },
 #endif
     { NS_FEEDSNIFFER_CONTRACTID, &kNS_FEEDSNIFFER_CID },
+#if defined(XP_LINUX)
+    { NS_FASTSHUTDOWN_CONTRACTID, &kNS_FASTSHUTDOWN_CID },
+#endif
 #ifdef XP_MACOSX
     { NS_SHELLSERVICE_CONTRACTID, &kNS_SHELLSERVICE_CID },
 #endif
@@ -78,6 +100,12 @@ static const mozilla::Module::ContractIDEntry kBrowserContracts[] = {
 static const mozilla::Module::CategoryEntry kBrowserCategories[] = {
     { XPCOM_DIRECTORY_PROVIDER_CATEGORY, "browser-directory-provider", NS_BROWSERDIRECTORYPROVIDER_CONTRACTID },
     { NS_CONTENT_SNIFFER_CATEGORY, "Feed Sniffer", NS_FEEDSNIFFER_CONTRACTID },
+#if defined(MOZ_WIDGET_GTK)
+    { "profile-after-change", "RemoteHandoffService", NS_REMOTEHANDOFFSERVICE_CONTRACTID },
+#endif
+#if defined(XP_LINUX)
+    { "profile-after-change", "FastShutdown", NS_FASTSHUTDOWN_CONTRACTID },
+#endif
     { nullptr }
 };
 
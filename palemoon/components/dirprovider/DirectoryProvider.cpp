@@ -23,13 +23,40 @@
 #include "nsStringAPI.h"
 #include "nsXULAppAPI.h"
 #include "nsIPrefLocalizedString.h"
+#include "nsThreadUtils.h"
+
+#ifdef XP_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef XP_LINUX
+#include <sys/inotify.h>
+#endif
 
 namespace mozilla {
 namespace browser {
 
+static char const *const kAppendSPlugins[] = {"searchplugins", nullptr};
+
+// Prefs that affect NS_APP_SEARCH_DIR_LIST.
+static const char* const kSearchDirPrefs[] = {
+  "general.useragent.locale",
+  "distribution.searchplugins.defaultLocale",
+  nullptr
+};
+
 NS_IMPL_ISUPPORTS(DirectoryProvider,
                    nsIDirectoryServiceProvider,
-                   nsIDirectoryServiceProvider2)
+                   nsIDirectoryServiceProvider2,
+                   nsIObserver)
+
+DirectoryProvider::DirectoryProvider()
+  : mSearchDirsValid(false)
+  , mObservingPrefs(false)
+{
+}
 
 NS_IMETHODIMP
 DirectoryProvider::GetFile(const char *aKey, bool *aPersist, nsIFile* *aResult)
@@ -37,18 +64,127 @@ DirectoryProvider::GetFile(const char *aKey, bool *aPersist, nsIFile* *aResult)
   return NS_ERROR_FAILURE;
 }
 
+typedef DirectoryProvider::SearchDirWatcher SearchDirWatcher;
+
+static bool
+FileExists(nsIFile* aFile, SearchDirWatcher* aWatcher)
+{
+  // Watch before probing, so that we can't miss a change in between.
+  if (aWatcher)
+    aWatcher->Watch(aFile);
+
+  bool exists;
+  nsresult rv = aFile->Exists(&exists);
+  return NS_SUCCEEDED(rv) && exists;
+}
+
+/**
+ * Append |aAppendList| to each of |aBases| and add the resulting files that
+ * exist to |aResult|, in order.
+ *
+ * Rather than building and stat()ing every path, which resolves the whole
+ * path each time, the bases are grouped by parent directory, each parent is
+ * opened once, and the files are probed with fstatat() relative to it.
+ * All extensions of a profile share a parent, so this saves most of the
+ * path lookups when many are installed.
+ */
+static void
+AppendExistingFiles(const nsCOMArray<nsIFile>& aBases,
+                    char const *const *aAppendList,
+                    nsCOMArray<nsIFile>& aResult,
+                    SearchDirWatcher* aWatcher)
+{
+  // Kept in step with each other.
+  nsCOMArray<nsIFile> bases, candidates;
+  for (int32_t i = 0; i < aBases.Count(); ++i) {
+    nsCOMPtr<nsIFile> file;
+    aBases[i]->Clone(getter_AddRefs(file));
+    if (!file)
+      continue;
+    for (char const *const *append = aAppendList; *append; ++append)
+      file->AppendNative(nsDependentCString(*append));
+    if (aWatcher)
+      aWatcher->Watch(file);
+    bases.AppendObject(aBases[i]);
+    candidates.AppendObject(file);
+  }
+
+#ifdef XP_UNIX
+  // Path of each candidate relative to its base's parent, i.e.
+  // "<base leaf>/<appended>/...".
+  nsAutoCString appended;
+  for (char const *const *append = aAppendList; *append; ++append) {
+    appended.Append('/');
+    appended.Append(*append);
+  }
+
+  struct ParentDir
+  {
+    nsCString mPath;
+    int mFd;
+  };
+  nsTArray<ParentDir> parents;
+
+  for (int32_t i = 0; i < candidates.Count(); ++i) {
+    nsCOMPtr<nsIFile> parent;
+    bases[i]->GetParent(getter_AddRefs(parent));
+    nsAutoCString parentPath, relativePath;
+    if (parent) {
+      parent->GetNativePath(parentPath);
+      bases[i]->GetNativeLeafName(relativePath);
+      relativePath.Append(appended);
+    }
+
+    int fd = -1;
+    if (!parentPath.IsEmpty()) {
+      uint32_t p = 0;
+      while (p < parents.Length() && !parents[p].mPath.Equals(parentPath))
+        ++p;
+      if (p == parents.Length()) {
+        ParentDir* dir = parents.AppendElement();
+        dir->mPath = parentPath;
+#ifdef O_PATH
+        dir->mFd = open(parentPath.get(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+        dir->mFd = open(parentPath.get(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+      }
+      fd = parents[p].mFd;
+    }
+
+    if (fd >= 0) {
+      struct stat st;
+      if (!fstatat(fd, relativePath.get(), &st, 0))
+        aResult.AppendObject(candidates[i]);
+    } else if (FileExists(candidates[i], nullptr)) {
+      // Let nsIFile sort out whatever is unusual about this one.
+      aResult.AppendObject(candidates[i]);
+    }
+  }
+
+  for (uint32_t p = 0; p < parents.Length(); ++p) {
+    if (parents[p].mFd >= 0)
+      close(parents[p].mFd);
+  }
+#else
+  for (int32_t i = 0; i < candidates.Count(); ++i) {
+    if (FileExists(candidates[i], nullptr))
+      aResult.AppendObject(candidates[i]);
+  }
+#endif
+}
+
+
 static void
 AppendFileKey(const char *key, nsIProperties* aDirSvc,
-              nsCOMArray<nsIFile> &array)
+              nsCOMArray<nsIFile> &array, SearchDirWatcher* aWatcher)
 {
   nsCOMPtr<nsIFile> file;
   nsresult rv = aDirSvc->Get(key, NS_GET_IID(nsIFile), getter_AddRefs(file));
   if (NS_FAILED(rv))
     return;
 
-  bool exists;
-  rv = file->Exists(&exists);
-  if (NS_FAILED(rv) || !exists)
+  if (!FileExists(file, aWatcher))
     return;
 
   array.AppendObject(file);
@@ -72,7 +208,8 @@ AppendFileKey(const char *key, nsIProperties* aDirSvc,
 // which specifies a default locale to use.
 
 static void
-AppendDistroSearchDirs(nsIProperties* aDirSvc, nsCOMArray<nsIFile> &array)
+AppendDistroSearchDirs(nsIProperties* aDirSvc, nsCOMArray<nsIFile> &array,
+                       SearchDirWatcher* aWatcher)
 {
   nsCOMPtr<nsIFile> searchPlugins;
   nsresult rv = aDirSvc->Get(XRE_APP_DISTRIBUTION_DIR,
@@ -82,17 +219,14 @@ AppendDistroSearchDirs(nsIProperties* aDirSvc, nsCOMArray<nsIFile> &array)
     return;
   searchPlugins->AppendNative(NS_LITERAL_CSTRING("searchplugins"));
 
-  bool exists;
-  rv = searchPlugins->Exists(&exists);
-  if (NS_FAILED(rv) || !exists)
+  if (!FileExists(searchPlugins, aWatcher))
     return;
 
   nsCOMPtr<nsIFile> commonPlugins;
   rv = searchPlugins->Clone(getter_AddRefs(commonPlugins));
   if (NS_SUCCEEDED(rv)) {
     commonPlugins->AppendNative(NS_LITERAL_CSTRING("common"));
-    rv = commonPlugins->Exists(&exists);
-    if (NS_SUCCEEDED(rv) && exists)
+    if (FileExists(commonPlugins, aWatcher))
         array.AppendObject(commonPlugins);
   }
 
@@ -126,8 +260,7 @@ AppendDistroSearchDirs(nsIProperties* aDirSvc, nsCOMArray<nsIFile> &array)
       if (NS_SUCCEEDED(rv)) {
 
         curLocalePlugins->AppendNative(locale);
-        rv = curLocalePlugins->Exists(&exists);
-        if (NS_SUCCEEDED(rv) && exists) {
+        if (FileExists(curLocalePlugins, aWatcher)) {
           array.AppendObject(curLocalePlugins);
           return; // all done
         }
@@ -145,8 +278,7 @@ AppendDistroSearchDirs(nsIProperties* aDirSvc, nsCOMArray<nsIFile> &array)
       if (NS_SUCCEEDED(rv)) {
 
         defLocalePlugins->AppendNative(defLocale);
-        rv = defLocalePlugins->Exists(&exists);
-        if (NS_SUCCEEDED(rv) && exists)
+        if (FileExists(defLocalePlugins, aWatcher))
           array.AppendObject(defLocalePlugins);
       }
     }
@@ -164,6 +296,9 @@ DirectoryProvider::GetFiles(const char *aKey, nsISimpleEnumerator* *aResult)
     if (!dirSvc)
       return NS_ERROR_FAILURE;
 
+    if (NS_IsMainThread() && mWatcher.Init())
+      return GetCachedSearchDirs(dirSvc, aResult);
+
     nsCOMArray<nsIFile> baseFiles;
 
     /**
@@ -175,9 +310,9 @@ DirectoryProvider::GetFiles(const char *aKey, nsISimpleEnumerator* *aResult)
      *   - user search plugin locations (profile)
      *   - app search plugin location (shipped engines)
      */
-    AppendDistroSearchDirs(dirSvc, baseFiles);
-    AppendFileKey(NS_APP_USER_SEARCH_DIR, dirSvc, baseFiles);
-    AppendFileKey(NS_APP_SEARCH_DIR, dirSvc, baseFiles);
+    AppendDistroSearchDirs(dirSvc, baseFiles, nullptr);
+    AppendFileKey(NS_APP_USER_SEARCH_DIR, dirSvc, baseFiles, nullptr);
+    AppendFileKey(NS_APP_SEARCH_DIR, dirSvc, baseFiles, nullptr);
 
     nsCOMPtr<nsISimpleEnumerator> baseEnum;
     rv = NS_NewArrayEnumerator(getter_AddRefs(baseEnum), baseFiles);
@@ -190,8 +325,6 @@ DirectoryProvider::GetFiles(const char *aKey, nsISimpleEnumerator* *aResult)
     if (NS_FAILED(rv))
       return rv;
 
-    static char const *const kAppendSPlugins[] = {"searchplugins", nullptr};
-
     nsCOMPtr<nsISimpleEnumerator> extEnum =
       new AppendingEnumerator(list, kAppendSPlugins);
     if (!extEnum)
@@ -203,65 +336,234 @@ DirectoryProvider::GetFiles(const char *aKey, nsISimpleEnumerator* *aResult)
   return NS_ERROR_FAILURE;
 }
 
-NS_IMPL_ISUPPORTS(DirectoryProvider::AppendingEnumerator, nsISimpleEnumerator)
+nsresult
+DirectoryProvider::GetCachedSearchDirs(nsIProperties* aDirSvc,
+                                       nsISimpleEnumerator** aResult)
+{
+  nsCOMPtr<nsISimpleEnumerator> list;
+  nsresult rv = aDirSvc->Get(XRE_EXTENSIONS_DIR_LIST,
+                             NS_GET_IID(nsISimpleEnumerator),
+                             getter_AddRefs(list));
+  if (NS_FAILED(rv))
+    return rv;
+
+  // The extension list is kept in memory, so comparing it is cheap.
+  nsCOMArray<nsIFile> extensionDirs;
+  nsTArray<nsCString> extensionPaths;
+  bool more;
+  while (NS_SUCCEEDED(list->HasMoreElements(&more)) && more) {
+    nsCOMPtr<nsISupports> supports;
+    list->GetNext(getter_AddRefs(supports));
+    nsCOMPtr<nsIFile> dir(do_QueryInterface(supports));
+    if (!dir)
+      continue;
+    dir->GetNativePath(*extensionPaths.AppendElement());
+    extensionDirs.AppendObject(dir);
+  }
+
+  // Always ask, so that pending events are consumed.
+  if (mWatcher.Changed() ||
+      extensionPaths.Length() != mExtensionDirs.Length())
+    mSearchDirsValid = false;
+  for (uint32_t i = 0; mSearchDirsValid && i < extensionPaths.Length(); ++i) {
+    if (!extensionPaths[i].Equals(mExtensionDirs[i]))
+      mSearchDirsValid = false;
+  }
+
+  if (!mSearchDirsValid) {
+    if (!mObservingPrefs) {
+      nsCOMPtr<nsIPrefBranch> prefs(do_GetService(NS_PREFSERVICE_CONTRACTID));
+      if (prefs) {
+        for (const char* const* pref = kSearchDirPrefs; *pref; ++pref)
+          prefs->AddObserver(*pref, this, false);
+        mObservingPrefs = true;
+      }
+    }
+
+    mWatcher.Reset();
+    mSearchDirs.Clear();
+
+    // Same order as the uncached list in GetFiles.
+    AppendExistingFiles(extensionDirs, kAppendSPlugins, mSearchDirs,
+                        &mWatcher);
+    AppendDistroSearchDirs(aDirSvc, mSearchDirs, &mWatcher);
+    AppendFileKey(NS_APP_USER_SEARCH_DIR, aDirSvc, mSearchDirs, &mWatcher);
+    AppendFileKey(NS_APP_SEARCH_DIR, aDirSvc, mSearchDirs, &mWatcher);
+
+    mExtensionDirs.SwapElements(extensionPaths);
+    // Without prefs we wouldn't notice a locale change.
+    mSearchDirsValid = mObservingPrefs;
+  }
+
+  // Hand out copies; callers are free to modify what they get.
+  nsCOMArray<nsIFile> dirs;
+  for (int32_t i = 0; i < mSearchDirs.Count(); ++i) {
+    nsCOMPtr<nsIFile> dir;
+    mSearchDirs[i]->Clone(getter_AddRefs(dir));
+    if (dir)
+      dirs.AppendObject(dir);
+  }
+
+  return NS_NewArrayEnumerator(aResult, dirs);
+}
 
 NS_IMETHODIMP
-DirectoryProvider::AppendingEnumerator::HasMoreElements(bool *aResult)
+DirectoryProvider::Observe(nsISupports* aSubject, const char* aTopic,
+                           const char16_t* aData)
 {
-  *aResult = mNext ? true : false;
+  if (!strcmp(aTopic, NS_PREFBRANCH_PREFCHANGE_TOPIC_ID))
+    mSearchDirsValid = false;
   return NS_OK;
 }
 
-NS_IMETHODIMP
-DirectoryProvider::AppendingEnumerator::GetNext(nsISupports* *aResult)
-{
-  if (aResult)
-    NS_ADDREF(*aResult = mNext);
+#ifdef XP_LINUX
+// Anything that makes a file appear or disappear in a directory.
+static const uint32_t kWatchMask =
+  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+  IN_MOVE_SELF | IN_ONLYDIR;
+#endif
 
-  mNext = nullptr;
+DirectoryProvider::SearchDirWatcher::~SearchDirWatcher()
+{
+#ifdef XP_LINUX
+  if (mFd >= 0)
+    close(mFd);
+#endif
+}
 
-  nsresult rv;
+bool
+DirectoryProvider::SearchDirWatcher::Init()
+{
+#ifdef XP_LINUX
+  if (mFd < 0)
+    mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  return mFd >= 0;
+#else
+  return false;
+#endif
+}
 
-  // Ignore all errors
+void
+DirectoryProvider::SearchDirWatcher::Reset()
+{
+#ifdef XP_LINUX
+  // Starting over with a new descriptor drops the events of the old
+  // watches, including the IN_IGNORED that removing them would queue.
+  if (mFd >= 0)
+    close(mFd);
+  mFd = -1;
+  mUnwatched = !Init();
+  mEntries.Clear();
+#endif
+}
 
-  bool more;
-  while (NS_SUCCEEDED(mBase->HasMoreElements(&more)) && more) {
-    nsCOMPtr<nsISupports> nextbasesupp;
-    mBase->GetNext(getter_AddRefs(nextbasesupp));
+void
+DirectoryProvider::SearchDirWatcher::Watch(nsIFile* aFile)
+{
+#ifdef XP_LINUX
+  // Watch the parent for |aFile|, or, if it doesn't exist either, the
+  // closest ancestor that does for the directory leading to it.
+  nsCOMPtr<nsIFile> child(aFile);
+  while (child) {
+    nsCOMPtr<nsIFile> parent;
+    child->GetParent(getter_AddRefs(parent));
+    if (!parent)
+      break;
 
-    nsCOMPtr<nsIFile> nextbase(do_QueryInterface(nextbasesupp));
-    if (!nextbase)
-      continue;
+    nsAutoCString parentPath;
+    parent->GetNativePath(parentPath);
+    int watch = inotify_add_watch(mFd, parentPath.get(), kWatchMask);
+    if (watch >= 0) {
+      Entry* entry = mEntries.AppendElement();
+      entry->mWatch = watch;
+      child->GetNativeLeafName(entry->mLeafName);
+      return;
+    }
+    if (errno != ENOENT && errno != ENOTDIR)
+      break;
 
-    nextbase->Clone(getter_AddRefs(mNext));
-    if (!mNext)
-      continue;
+    child = parent;
+  }
+  mUnwatched = true;
+#endif
+}
 
-    char const *const * i = mAppendList;
-    while (*i) {
-      mNext->AppendNative(nsDependentCString(*i));
-      ++i;
+bool
+DirectoryProvider::SearchDirWatcher::Changed()
+{
+#ifdef XP_LINUX
+  if (mFd < 0 || mUnwatched)
+    return true;
+
+  bool changed = false;
+  char buffer[4096]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+  while ((length = read(mFd, buffer, sizeof(buffer))) > 0) {
+    for (char* p = buffer; p < buffer + length; ) {
+      const struct inotify_event* event =
+        reinterpret_cast<const struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF |
+                         IN_MOVE_SELF | IN_UNMOUNT)) {
+        changed = true;
+        continue;
+      }
+      if (!event->len)
+        continue;
+      for (uint32_t i = 0; i < mEntries.Length(); ++i) {
+        if (mEntries[i].mWatch == event->wd &&
+            mEntries[i].mLeafName.Equals(event->name)) {
+          changed = true;
+          break;
+        }
+      }
     }
+  }
+  return changed;
+#else
+  return true;
+#endif
+}
 
-    bool exists;
-    rv = mNext->Exists(&exists);
-    if (NS_SUCCEEDED(rv) && exists)
-      break;
+NS_IMPL_ISUPPORTS(DirectoryProvider::AppendingEnumerator, nsISimpleEnumerator)
 
-    mNext = nullptr;
-  }
+NS_IMETHODIMP
+DirectoryProvider::AppendingEnumerator::HasMoreElements(bool *aResult)
+{
+  *aResult = mNextIndex < mResults.Count();
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+DirectoryProvider::AppendingEnumerator::GetNext(nsISupports* *aResult)
+{
+  if (mNextIndex >= mResults.Count())
+    return NS_ERROR_FAILURE;
 
+  NS_ADDREF(*aResult = mResults[mNextIndex++]);
   return NS_OK;
 }
 
 DirectoryProvider::AppendingEnumerator::AppendingEnumerator
     (nsISimpleEnumerator* aBase,
      char const *const *aAppendList) :
-  mBase(aBase),
-  mAppendList(aAppendList)
+  mNextIndex(0)
 {
-  // Initialize mNext to begin.
-  GetNext(nullptr);
+  // Probe all of them in one go; ignore all errors.
+  nsCOMArray<nsIFile> bases;
+  bool more;
+  while (NS_SUCCEEDED(aBase->HasMoreElements(&more)) && more) {
+    nsCOMPtr<nsISupports> nextbasesupp;
+    aBase->GetNext(getter_AddRefs(nextbasesupp));
+
+    nsCOMPtr<nsIFile> nextbase(do_QueryInterface(nextbasesupp));
+    if (nextbase)
+      bases.AppendObject(nextbase);
+  }
+
+  AppendExistingFiles(bases, aAppendList, mResults, nullptr);
 }
 
 } // namespace browser
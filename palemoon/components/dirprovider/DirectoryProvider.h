@@ -9,6 +9,10 @@
 #include "nsComponentManagerUtils.h"
 #include "nsISimpleEnumerator.h"
 #include "nsIFile.h"
+#include "nsIObserver.h"
+#include "nsCOMArray.h"
+#include "nsTArray.h"
+#include "nsStringAPI.h"
 #include "mozilla/Attributes.h"
 
 #define NS_BROWSERDIRECTORYPROVIDER_CONTRACTID \
@@ -18,15 +22,64 @@ namespace mozilla {
 namespace browser {
 
 class DirectoryProvider final : public nsIDirectoryServiceProvider2
+                              , public nsIObserver
 {
 public:
   NS_DECL_ISUPPORTS
   NS_DECL_NSIDIRECTORYSERVICEPROVIDER
   NS_DECL_NSIDIRECTORYSERVICEPROVIDER2
+  NS_DECL_NSIOBSERVER
+
+  DirectoryProvider();
+
+  /**
+   * Remembers the files probed while building a list, and tells whether
+   * any of them may have appeared or disappeared since. Uses inotify, so it
+   * is only available on Linux.
+   */
+  class SearchDirWatcher
+  {
+  public:
+    SearchDirWatcher() : mFd(-1), mUnwatched(false) {}
+    ~SearchDirWatcher();
+
+    // @return false if we can't watch files.
+    bool Init();
+    // Watch for |aFile| being created or removed.
+    void Watch(nsIFile* aFile);
+    // Drop all watches.
+    void Reset();
+    // @return true if a watched file may have changed since the last call.
+    bool Changed();
+
+  private:
+    struct Entry
+    {
+      int mWatch;
+      nsCString mLeafName;
+    };
+
+    int mFd;
+    // Set when a file couldn't be watched, e.g. for lack of permission.
+    bool mUnwatched;
+    nsTArray<Entry> mEntries;
+  };
 
 private:
   ~DirectoryProvider() {}
 
+  nsresult GetCachedSearchDirs(nsIProperties* aDirSvc,
+                               nsISimpleEnumerator** aResult);
+
+  // The resolved NS_APP_SEARCH_DIR_LIST, valid while mSearchDirsValid is set
+  // and mWatcher reports no change.
+  nsCOMArray<nsIFile> mSearchDirs;
+  // The XRE_EXTENSIONS_DIR_LIST it was built from.
+  nsTArray<nsCString> mExtensionDirs;
+  bool mSearchDirsValid;
+  bool mObservingPrefs;
+  SearchDirWatcher mWatcher;
+
   class AppendingEnumerator final : public nsISimpleEnumerator
   {
   public:
@@ -39,9 +92,9 @@ private:
   private:
     ~AppendingEnumerator() {}
 
-    nsCOMPtr<nsISimpleEnumerator> mBase;
-    char const *const *const      mAppendList;
-    nsCOMPtr<nsIFile>             mNext;
+    // The existing files, resolved when we are created.
+    nsCOMArray<nsIFile>           mResults;
+    int32_t                       mNextIndex;
   };
 };
 
@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsFeedSniffCache.h"
+
+#include "nsCOMPtr.h"
+#include "nsThreadUtils.h"
+#include "nsServiceManagerUtils.h"
+#include "nsIObserverService.h"
+#include "nsIHttpChannel.h"
+#include "nsIInterfaceRequestor.h"
+#include "nsIInterfaceRequestorUtils.h"
+#include "nsILoadContext.h"
+#include "nsILoadGroup.h"
+#include "nsIURI.h"
+#include "mozilla/StaticPtr.h"
+#include <string.h>
+
+using namespace mozilla;
+
+// Maximum number of verdicts we remember.
+#define MAX_ENTRIES 256
+
+static StaticRefPtr<nsFeedSniffCache> sCache;
+static bool sShutdown = false;
+
+NS_IMPL_ISUPPORTS(nsFeedSniffCache, nsIObserver)
+
+nsFeedSniffCache::nsFeedSniffCache()
+  : mHits(0)
+  , mMisses(0)
+{
+}
+
+nsFeedSniffCache*
+nsFeedSniffCache::GetSingleton()
+{
+  MOZ_ASSERT(NS_IsMainThread());
+
+  if (!sCache && !sShutdown) {
+    nsCOMPtr<nsIObserverService> obs =
+      do_GetService("@mozilla.org/observer-service;1");
+    if (!obs)
+      return nullptr;
+
+    sCache = new nsFeedSniffCache();
+    obs->AddObserver(sCache, "memory-pressure", false);
+    obs->AddObserver(sCache, "xpcom-shutdown", false);
+  }
+  return sCache;
+}
+
+static bool
+IsPrivateLoad(nsIChannel* aChannel)
+{
+  nsCOMPtr<nsIInterfaceRequestor> callbacks;
+  aChannel->GetNotificationCallbacks(getter_AddRefs(callbacks));
+  nsCOMPtr<nsILoadContext> loadContext = do_GetInterface(callbacks);
+  if (!loadContext) {
+    nsCOMPtr<nsILoadGroup> loadGroup;
+    aChannel->GetLoadGroup(getter_AddRefs(loadGroup));
+    if (loadGroup) {
+      loadGroup->GetNotificationCallbacks(getter_AddRefs(callbacks));
+      loadContext = do_GetInterface(callbacks);
+    }
+  }
+
+  bool isPrivate = false;
+  if (loadContext)
+    loadContext->GetUsePrivateBrowsing(&isPrivate);
+  return isPrivate;
+}
+
+bool
+nsFeedSniffCache::GetKey(nsIHttpChannel* aChannel, nsACString& aKey)
+{
+  nsAutoCString etag, lastModified;
+  aChannel->GetResponseHeader(NS_LITERAL_CSTRING("ETag"), etag);
+  aChannel->GetResponseHeader(NS_LITERAL_CSTRING("Last-Modified"),
+                              lastModified);
+  // Without a validator we can't tell whether the body changed.
+  if (etag.IsEmpty() && lastModified.IsEmpty())
+    return false;
+
+  if (IsPrivateLoad(aChannel))
+    return false;
+
+  nsCOMPtr<nsIURI> uri;
+  aChannel->GetURI(getter_AddRefs(uri));
+  if (!uri)
+    return false;
+
+  nsAutoCString spec;
+  if (NS_FAILED(uri->GetSpecIgnoringRef(spec)))
+    return false;
+
+  nsAutoCString contentType;
+  aChannel->GetContentType(contentType);
+
+  aKey = spec;
+  aKey.Append('\n');
+  aKey.Append(etag);
+  aKey.Append('\n');
+  aKey.Append(lastModified);
+  aKey.Append('\n');
+  aKey.Append(contentType);
+  return true;
+}
+
+bool
+nsFeedSniffCache::Lookup(const nsACString& aKey, bool* aIsFeed)
+{
+  Entry* entry = mEntries.Get(aKey);
+  if (!entry) {
+    ++mMisses;
+    return false;
+  }
+
+  ++mHits;
+  // Move it to the front of the LRU list.
+  entry->remove();
+  mLRU.insertFront(entry);
+
+  *aIsFeed = entry->mIsFeed;
+  return true;
+}
+
+void
+nsFeedSniffCache::Put(const nsACString& aKey, bool aIsFeed)
+{
+  Entry* entry = mEntries.Get(aKey);
+  if (entry) {
+    entry->remove();
+  } else {
+    if (mEntries.Count() >= MAX_ENTRIES) {
+      Entry* oldest = mLRU.popLast();
+      mEntries.Remove(oldest->mKey);
+    }
+    entry = new Entry(aKey);
+    mEntries.Put(aKey, entry);
+  }
+
+  entry->mIsFeed = aIsFeed;
+  mLRU.insertFront(entry);
+}
+
+void
+nsFeedSniffCache::Clear()
+{
+  // The hashtable owns the entries, so unlink them before it deletes them.
+  mLRU.clear();
+  mEntries.Clear();
+}
+
+NS_IMETHODIMP
+nsFeedSniffCache::Observe(nsISupports* aSubject, const char* aTopic,
+                          const char16_t* aData)
+{
+  if (!strcmp(aTopic, "memory-pressure")) {
+    Clear();
+  } else if (!strcmp(aTopic, "xpcom-shutdown")) {
+    nsCOMPtr<nsIObserverService> obs =
+      do_GetService("@mozilla.org/observer-service;1");
+    if (obs) {
+      obs->RemoveObserver(this, "memory-pressure");
+      obs->RemoveObserver(this, "xpcom-shutdown");
+    }
+    Clear();
+    sShutdown = true;
+    sCache = nullptr;
+  }
+  return NS_OK;
+}
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsFeedSniffCache_h__
+#define nsFeedSniffCache_h__
+
+#include "nsIObserver.h"
+#include "nsClassHashtable.h"
+#include "nsHashKeys.h"
+#include "nsStringAPI.h"
+#include "mozilla/Attributes.h"
+#include "mozilla/LinkedList.h"
+
+class nsIHttpChannel;
+
+/**
+ * A small LRU cache of feed sniffing verdicts.
+ *
+ * Entries are keyed on the URI of the response together with its ETag,
+ * Last-Modified and Content-Type headers, so a verdict is only reused for a
+ * response that the server tells us is unchanged. Responses without any
+ * validator, and responses in private windows, are never cached.
+ *
+ * The cache lives on the main thread and is dropped on memory pressure.
+ */
+class nsFeedSniffCache final : public nsIObserver
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIOBSERVER
+
+  /**
+   * @return the cache shared by all feed sniffers, creating it on first use,
+   *         or nullptr once XPCOM is shutting down.
+   */
+  static nsFeedSniffCache* GetSingleton();
+
+  /**
+   * Build the cache key for a response.
+   * @returns false if the response must not be cached.
+   */
+  static bool GetKey(nsIHttpChannel* aChannel, nsACString& aKey);
+
+  /**
+   * @returns true and sets |aIsFeed| if a verdict for |aKey| is cached.
+   */
+  bool Lookup(const nsACString& aKey, bool* aIsFeed);
+
+  void Put(const nsACString& aKey, bool aIsFeed);
+
+  void Clear();
+
+  uint32_t Hits() const { return mHits; }
+  uint32_t Misses() const { return mMisses; }
+
+private:
+  nsFeedSniffCache();
+  ~nsFeedSniffCache() { Clear(); }
+
+  struct Entry : public mozilla::LinkedListElement<Entry>
+  {
+    explicit Entry(const nsACString& aKey) : mKey(aKey), mIsFeed(false) {}
+
+    nsCString mKey;
+    bool mIsFeed;
+  };
+
+  // Owns the entries. mLRU orders the same entries from the most to the least
+  // recently used.
+  nsClassHashtable<nsCStringHashKey, Entry> mEntries;
+  mozilla::LinkedList<Entry> mLRU;
+
+  uint32_t mHits;
+  uint32_t mMisses;
+};
+
+#endif // nsFeedSniffCache_h__
@@ -4,7 +4,9 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "nsFeedSniffer.h"
-
+#include "nsFeedSniffCache.h"
+#include "nsFeedSnifferScan.h"
+#include "nsFeedSnifferStats.h"
 
 #include "nsNetCID.h"
 #include "nsXPCOM.h"
@@ -29,6 +31,10 @@
 #include "nsMimeTypes.h"
 #include "nsIURI.h"
 #include <algorithm>
+#include <string.h>
+
+using namespace mozilla;
+using namespace mozilla::browser;
 
 #define TYPE_ATOM "application/atom+xml"
 #define TYPE_RSS "application/rss+xml"
@@ -37,7 +43,13 @@
 #define NS_RDF "http://www.w3.org/1999/02/22-rdf-syntax-ns#"
 #define NS_RSS "http://purl.org/rss/1.0/"
 
-#define MAX_BYTES 512u
+#define MAX_BYTES nsFeedSniffer::kMaxSniffBytes
+
+// Compressed input is handed to the decoder in slices of this size, so that
+// we can stop feeding it once the first MAX_BYTES have been decoded.
+#define ENCODED_CHUNK_BYTES 4096u
+
+const uint32_t nsFeedSniffer::kMaxSniffBytes;
 
 NS_IMPL_ISUPPORTS(nsFeedSniffer,
                   nsIContentSniffer,
@@ -51,8 +63,8 @@ nsFeedSniffer::ConvertEncodedData(nsIRequest* request,
 {
   nsresult rv = NS_OK;
 
- mDecodedData = "";
- nsCOMPtr<nsIHttpChannel> httpChannel(do_QueryInterface(request));
+  mDecodedLength = 0;
+  nsCOMPtr<nsIHttpChannel> httpChannel(do_QueryInterface(request));
   if (!httpChannel)
     return NS_ERROR_NO_INTERFACE;
 
@@ -70,6 +82,7 @@ nsFeedSniffer::ConvertEncodedData(nsIRequest* request,
                                               getter_AddRefs(converter));
       NS_ENSURE_SUCCESS(rv, rv);
 
+      TimeStamp start = TimeStamp::Now();
       converter->OnStartRequest(request, nullptr);
 
       nsCOMPtr<nsIStringInputStream> rawStream =
@@ -77,13 +90,30 @@ nsFeedSniffer::ConvertEncodedData(nsIRequest* request,
       if (!rawStream)
         return NS_ERROR_FAILURE;
 
-      rv = rawStream->SetData((const char*)data, length);
-      NS_ENSURE_SUCCESS(rv, rv);
-
-      rv = converter->OnDataAvailable(request, nullptr, rawStream, 0, length);
-      NS_ENSURE_SUCCESS(rv, rv);
+      // Feed the decoder slice by slice and stop as soon as we have decoded
+      // everything we are going to look at. Once our buffer is full,
+      // OnDataAvailable fails with NS_BINDING_ABORTED to make the decoder
+      // stop inflating the slice it is working on.
+      uint32_t offset = 0;
+      while (offset < length && mDecodedLength < MAX_BYTES) {
+        uint32_t count = std::min(length - offset, ENCODED_CHUNK_BYTES);
+        rv = rawStream->ShareData((const char*)data + offset, count);
+        NS_ENSURE_SUCCESS(rv, rv);
+
+        rv = converter->OnDataAvailable(request, nullptr, rawStream, offset,
+                                        count);
+        if (NS_FAILED(rv) && mDecodedLength < MAX_BYTES)
+          return rv;
+
+        offset += count;
+      }
+      rv = NS_OK;
 
       converter->OnStopRequest(request, nullptr, NS_OK);
+
+      nsFeedSnifferStats* stats = nsFeedSnifferStats::Get();
+      if (stats)
+        stats->RecordDecode(TimeStamp::Now() - start, offset, mDecodedLength);
     }
   }
   return rv;
@@ -112,6 +142,10 @@ HasAttachmentDisposition(nsIHttpChannel* httpChannel)
   return false;
 }
 
+#ifdef DEBUG
+// The original multi-pass search, kept around in debug builds to verify that
+// feedscan::ClassifyRootElement reaches the same verdicts.
+
 /**
  * @return the first occurrence of a character within a string buffer,
  *         or nullptr if not found
@@ -195,12 +229,28 @@ ContainsTopLevelSubstring(nsACString& dataString, const char *substring)
   return IsDocumentElement(begin, begin + offset);
 }
 
+static feedscan::RootElement
+ClassifyRootElementSlow(nsACString& dataString)
+{
+  if (ContainsTopLevelSubstring(dataString, "<rss"))
+    return feedscan::RootElement::RSS;
+  if (ContainsTopLevelSubstring(dataString, "<feed"))
+    return feedscan::RootElement::Feed;
+  if (ContainsTopLevelSubstring(dataString, "<rdf:RDF"))
+    return feedscan::RootElement::RDF;
+  return feedscan::RootElement::Other;
+}
+#endif
+
 NS_IMETHODIMP
 nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request, 
                                       const uint8_t* data, 
                                       uint32_t length, 
                                       nsACString& sniffedType)
 {
+  nsFeedSnifferStats::AutoTimer timer(sniffedType);
+  nsFeedSnifferStats* stats = nsFeedSnifferStats::Get();
+
   nsCOMPtr<nsIHttpChannel> channel(do_QueryInterface(request));
   if (!channel)
     return NS_ERROR_NO_INTERFACE;
@@ -209,6 +259,8 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
   nsAutoCString method;
   channel->GetRequestMethod(method);
   if (!method.EqualsLiteral("GET")) {
+    if (stats)
+      stats->RecordEarlyOut(nsFeedSnifferStats::eNotGet);
     sniffedType.Truncate();
     return NS_OK;
   }
@@ -226,6 +278,8 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
   nsAutoCString scheme;
   originalURI->GetScheme(scheme);
   if (scheme.EqualsLiteral("view-source")) {
+    if (stats)
+      stats->RecordEarlyOut(nsFeedSnifferStats::eViewSource);
     sniffedType.Truncate();
     return NS_OK;
   }
@@ -236,8 +290,9 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
   // doing. 
   nsAutoCString contentType;
   channel->GetContentType(contentType);
-  bool noSniff = contentType.EqualsLiteral(TYPE_RSS) ||
-                   contentType.EqualsLiteral(TYPE_ATOM);
+  bool feedContentType = contentType.EqualsLiteral(TYPE_RSS) ||
+                         contentType.EqualsLiteral(TYPE_ATOM);
+  bool noSniff = feedContentType;
 
   // Check to see if this was a feed request from the location bar or from
   // the feed: protocol. This is also a reliable indication.
@@ -250,6 +305,12 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
     noSniff = NS_SUCCEEDED(foundHeader);
   }
 
+  if (noSniff && stats) {
+    stats->RecordEarlyOut(feedContentType ?
+                          nsFeedSnifferStats::eFeedContentType :
+                          nsFeedSnifferStats::eFeedHeader);
+  }
+
   if (noSniff) {
     // check for an attachment after we have a likely feed.
     if(HasAttachmentDisposition(channel)) {
@@ -272,10 +333,30 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
       // Same criterion as XMLHttpRequest.  Should we be checking for "+xml"
       // and check for text/xml and application/xml by hand instead?
       contentType.Find("xml") == -1) {
+    if (stats)
+      stats->RecordEarlyOut(nsFeedSnifferStats::eContentType);
     sniffedType.Truncate();
     return NS_OK;
   }
 
+  // If we have already sniffed this very response, reuse the verdict without
+  // looking at (or decoding) the body again.
+  nsFeedSniffCache* cache = nsFeedSniffCache::GetSingleton();
+  nsAutoCString cacheKey;
+  bool cacheable = cache && nsFeedSniffCache::GetKey(channel, cacheKey);
+  if (cacheable) {
+    bool isFeed;
+    if (cache->Lookup(cacheKey, &isFeed)) {
+      if (stats)
+        stats->RecordEarlyOut(nsFeedSnifferStats::eCacheHit);
+      if (isFeed && !HasAttachmentDisposition(channel))
+        sniffedType.AssignLiteral(TYPE_MAYBE_FEED);
+      else
+        sniffedType.Truncate();
+      return NS_OK;
+    }
+  }
+
   // Now we need to potentially decompress data served with 
   // Content-Encoding: gzip
   nsresult rv = ConvertEncodedData(request, data, length);
@@ -285,13 +366,28 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
   // We cap the number of bytes to scan at MAX_BYTES to prevent picking up 
   // false positives by accidentally reading document content, e.g. a "how to
   // make a feed" page.
+  const uint32_t rawLength = length;
   const char* testData;
-  if (mDecodedData.IsEmpty()) {
+  if (!mDecodedLength) {
     testData = (const char*)data;
     length = std::min(length, MAX_BYTES);
   } else {
-    testData = mDecodedData.get();
-    length = std::min(mDecodedData.Length(), MAX_BYTES);
+    testData = mDecodedData;
+    length = mDecodedLength;
+  }
+
+  // UTF-16 and UTF-32 documents are narrowed to one byte per character so
+  // that they can be sniffed just like ASCII compatible ones.
+  const uint32_t sniffedBytes = length;
+  char narrowed[MAX_BYTES];
+  uint32_t bomLength;
+  feedscan::Encoding encoding =
+    feedscan::DetectEncoding(testData, length, &bomLength);
+  testData += bomLength;
+  length -= bomLength;
+  if (encoding != feedscan::Encoding::Bytes) {
+    length = feedscan::NarrowToASCII(encoding, testData, length, narrowed);
+    testData = narrowed;
   }
 
   // The strategy here is based on that described in:
@@ -301,21 +397,46 @@ nsFeedSniffer::GetMIMETypeFromContent(nsIRequest* request,
   // Thus begins the actual sniffing.
   nsDependentCSubstring dataString((const char*)testData, length);
 
-  bool isFeed = false;
-
-  // RSS 0.91/0.92/2.0
-  isFeed = ContainsTopLevelSubstring(dataString, "<rss");
+  // Find the documentElement in a single walk over the prolog.
+  feedscan::RootElement root =
+    feedscan::ClassifyRootElement(testData, length);
+
+#ifdef DEBUG
+  {
+    feedscan::RootElement slow = ClassifyRootElementSlow(dataString);
+    MOZ_ASSERT(slow == root ||
+               (slow == feedscan::RootElement::Other &&
+                root == feedscan::RootElement::None),
+               "Single-pass root element scan disagrees with the old search");
+  }
+#endif
 
-  // Atom 1.0
-  if (!isFeed)
-    isFeed = ContainsTopLevelSubstring(dataString, "<feed");
+  bool isFeed = false;
+  switch (root) {
+    // RSS 0.91/0.92/2.0
+    case feedscan::RootElement::RSS:
+    // Atom 1.0
+    case feedscan::RootElement::Feed:
+      isFeed = true;
+      break;
+    // RSS 1.0
+    case feedscan::RootElement::RDF:
+      isFeed = dataString.Find(NS_RDF) != -1 &&
+               dataString.Find(NS_RSS) != -1;
+      break;
+    default:
+      break;
+  }
 
-  // RSS 1.0
-  if (!isFeed) {
-    isFeed = ContainsTopLevelSubstring(dataString, "<rdf:RDF") &&
-      dataString.Find(NS_RDF) != -1 &&
-      dataString.Find(NS_RSS) != -1;
+  // A verdict based on a partial prolog might change once more data is
+  // available, so only remember it if we saw all we would ever look at.
+  if (cacheable && sniffedBytes < MAX_BYTES) {
+    int64_t contentLength = -1;
+    channel->GetContentLength(&contentLength);
+    cacheable = contentLength == int64_t(rawLength);
   }
+  if (cacheable)
+    cache->Put(cacheKey, isFeed);
 
   // If we sniffed a feed, coerce our internal type
   if (isFeed && !HasAttachmentDisposition(channel))
@@ -339,8 +460,11 @@ nsFeedSniffer::AppendSegmentToString(nsIInputStream* inputStream,
                                      uint32_t count,
                                      uint32_t* writeCount)
 {
-  nsCString* decodedData = static_cast<nsCString*>(closure);
-  decodedData->Append(rawSegment, count);
+  nsFeedSniffer* sniffer = static_cast<nsFeedSniffer*>(closure);
+  uint32_t wanted = std::min(count, MAX_BYTES - sniffer->mDecodedLength);
+  memcpy(sniffer->mDecodedData + sniffer->mDecodedLength, rawSegment, wanted);
+  sniffer->mDecodedLength += wanted;
+  // Consume the whole segment, even the part we don't keep.
   *writeCount = count;
   return NS_OK;
 }
@@ -351,8 +475,12 @@ nsFeedSniffer::OnDataAvailable(nsIRequest* request, nsISupports* context,
                                uint32_t count)
 {
   uint32_t read;
-  return stream->ReadSegments(AppendSegmentToString, &mDecodedData, count, 
-                              &read);
+  nsresult rv = stream->ReadSegments(AppendSegmentToString, this, count, 
+                                     &read);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  // Tell the decoder that we've seen enough.
+  return mDecodedLength < MAX_BYTES ? NS_OK : NS_BINDING_ABORTED;
 }
 
 NS_IMETHODIMP
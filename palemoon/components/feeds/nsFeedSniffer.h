@@ -25,6 +25,11 @@ public:
                                         uint32_t count,
                                         uint32_t* writeCount);
 
+  // We never look at more than this many bytes of a document.
+  static const uint32_t kMaxSniffBytes = 512;
+
+  nsFeedSniffer() : mDecodedLength(0) {}
+
 protected:
   ~nsFeedSniffer() {}
 
@@ -32,6 +37,10 @@ protected:
                               uint32_t length);
 
 private:
-  nsCString mDecodedData;
+  // Scratch buffer for the decoded start of a Content-Encoded document. It is
+  // reused for every request this sniffer sees, and decoding stops as soon as
+  // it is full.
+  char mDecodedData[kMaxSniffBytes];
+  uint32_t mDecodedLength;
 };
 
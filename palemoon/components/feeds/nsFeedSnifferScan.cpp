@@ -0,0 +1,242 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsFeedSnifferScan.h"
+
+#include "mozilla/Assertions.h"
+#include <string.h>
+
+namespace mozilla {
+namespace browser {
+namespace feedscan {
+
+const char*
+FindFirstOf_Scalar(const char* aBegin, const char* aEnd,
+                   char aChar1, char aChar2)
+{
+  for (; aBegin < aEnd; ++aBegin) {
+    if (*aBegin == aChar1 || *aBegin == aChar2)
+      return aBegin;
+  }
+  return nullptr;
+}
+
+static const char*
+FindFirstOfDispatch(const char* aBegin, const char* aEnd,
+                    char aChar1, char aChar2)
+{
+#ifdef MOZILLA_MAY_SUPPORT_AVX2
+  if (mozilla::supports_avx2())
+    return FindFirstOf_AVX2(aBegin, aEnd, aChar1, aChar2);
+#endif
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2())
+    return FindFirstOf_SSE2(aBegin, aEnd, aChar1, aChar2);
+#endif
+#ifdef BUILD_ARM_NEON
+  if (mozilla::supports_neon())
+    return FindFirstOf_NEON(aBegin, aEnd, aChar1, aChar2);
+#endif
+  return FindFirstOf_Scalar(aBegin, aEnd, aChar1, aChar2);
+}
+
+const char*
+FindFirstOf(const char* aBegin, const char* aEnd, char aChar1, char aChar2)
+{
+  const char* found = FindFirstOfDispatch(aBegin, aEnd, aChar1, aChar2);
+  MOZ_ASSERT(found == FindFirstOf_Scalar(aBegin, aEnd, aChar1, aChar2),
+             "Vectorized search disagrees with the scalar one");
+  return found;
+}
+
+Encoding
+DetectEncoding(const char* aData, uint32_t aLength, uint32_t* aBOMLength)
+{
+  const uint8_t* b = reinterpret_cast<const uint8_t*>(aData);
+  *aBOMLength = 0;
+
+  // Byte order marks. UTF-32LE has to be checked before UTF-16LE, whose mark
+  // it starts with.
+  if (aLength >= 4) {
+    if (b[0] == 0x00 && b[1] == 0x00 && b[2] == 0xFE && b[3] == 0xFF) {
+      *aBOMLength = 4;
+      return Encoding::UTF32BE;
+    }
+    if (b[0] == 0xFF && b[1] == 0xFE && b[2] == 0x00 && b[3] == 0x00) {
+      *aBOMLength = 4;
+      return Encoding::UTF32LE;
+    }
+  }
+  if (aLength >= 3 && b[0] == 0xEF && b[1] == 0xBB && b[2] == 0xBF) {
+    *aBOMLength = 3;
+    return Encoding::Bytes;
+  }
+  if (aLength >= 2) {
+    if (b[0] == 0xFE && b[1] == 0xFF) {
+      *aBOMLength = 2;
+      return Encoding::UTF16BE;
+    }
+    if (b[0] == 0xFF && b[1] == 0xFE) {
+      *aBOMLength = 2;
+      return Encoding::UTF16LE;
+    }
+  }
+
+  // No mark; look for an ASCII character padded with zero bytes, e.g. the
+  // '<' of '<?xml' or of the root element.
+  if (aLength < 4)
+    return Encoding::Bytes;
+
+#define IS_ASCII(c) ((c) && (c) < 0x80)
+  if (!b[0] && !b[1] && !b[2] && IS_ASCII(b[3]))
+    return Encoding::UTF32BE;
+  if (IS_ASCII(b[0]) && !b[1] && !b[2] && !b[3])
+    return Encoding::UTF32LE;
+  if (!b[0] && IS_ASCII(b[1]) && !b[2] && IS_ASCII(b[3]))
+    return Encoding::UTF16BE;
+  if (IS_ASCII(b[0]) && !b[1] && IS_ASCII(b[2]) && !b[3])
+    return Encoding::UTF16LE;
+#undef IS_ASCII
+
+  return Encoding::Bytes;
+}
+
+void
+NarrowUTF16_Scalar(const char* aData, uint32_t aUnits, bool aBigEndian,
+                   char* aDest)
+{
+  const uint8_t* b = reinterpret_cast<const uint8_t*>(aData);
+  for (uint32_t i = 0; i < aUnits; ++i, b += 2) {
+    uint16_t unit = aBigEndian ? (b[0] << 8) | b[1] : (b[1] << 8) | b[0];
+    aDest[i] = char(unit < 0x80 ? unit : 0x80);
+  }
+}
+
+static void
+NarrowUTF32(const char* aData, uint32_t aUnits, bool aBigEndian, char* aDest)
+{
+  const uint8_t* b = reinterpret_cast<const uint8_t*>(aData);
+  for (uint32_t i = 0; i < aUnits; ++i, b += 4) {
+    uint32_t unit = aBigEndian ?
+      (uint32_t(b[0]) << 24) | (b[1] << 16) | (b[2] << 8) | b[3] :
+      (uint32_t(b[3]) << 24) | (b[2] << 16) | (b[1] << 8) | b[0];
+    aDest[i] = char(unit < 0x80 ? unit : 0x80);
+  }
+}
+
+uint32_t
+NarrowToASCII(Encoding aEncoding, const char* aData, uint32_t aLength,
+              char* aDest)
+{
+  uint32_t units;
+  switch (aEncoding) {
+    case Encoding::UTF16LE:
+    case Encoding::UTF16BE: {
+      bool bigEndian = aEncoding == Encoding::UTF16BE;
+      units = aLength / 2;
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+      if (mozilla::supports_sse2()) {
+        NarrowUTF16_SSE2(aData, units, bigEndian, aDest);
+        break;
+      }
+#endif
+#ifdef BUILD_ARM_NEON
+      if (mozilla::supports_neon()) {
+        NarrowUTF16_NEON(aData, units, bigEndian, aDest);
+        break;
+      }
+#endif
+      NarrowUTF16_Scalar(aData, units, bigEndian, aDest);
+      break;
+    }
+    case Encoding::UTF32LE:
+    case Encoding::UTF32BE:
+      // Rare enough that it isn't worth a vectorized version.
+      units = aLength / 4;
+      NarrowUTF32(aData, units, aEncoding == Encoding::UTF32BE, aDest);
+      break;
+    default:
+      MOZ_ASSERT_UNREACHABLE("Nothing to narrow");
+      units = 0;
+      break;
+  }
+  return units;
+}
+
+template<size_t N>
+static bool
+StartsWithLiteral(const char* aPos, const char* aEnd,
+                  const char (&aLiteral)[N])
+{
+  return size_t(aEnd - aPos) >= N - 1 && !memcmp(aPos, aLiteral, N - 1);
+}
+
+/**
+ * @return which of our indicator substrings starts at |aPos|, or
+ *         RootElement::Other if none does.
+ */
+static RootElement
+MatchIndicator(const char* aPos, const char* aEnd)
+{
+  if (StartsWithLiteral(aPos, aEnd, "<rss"))
+    return RootElement::RSS;
+  if (StartsWithLiteral(aPos, aEnd, "<feed"))
+    return RootElement::Feed;
+  if (StartsWithLiteral(aPos, aEnd, "<rdf:RDF"))
+    return RootElement::RDF;
+  return RootElement::Other;
+}
+
+RootElement
+ClassifyRootElement(const char* aData, uint32_t aLength)
+{
+  return ClassifyRootElement(aData, aLength, FindFirstOf);
+}
+
+RootElement
+ClassifyRootElement(const char* aData, uint32_t aLength,
+                    FindFirstOfKernel aFindFirstOf)
+{
+  const char* pos = aData;
+  const char* end = aData + aLength;
+
+  // Indicators that occur inside a PI, doctype or comment before the root
+  // element. The old search only ever looked at the first occurrence of each
+  // indicator, so one of these hides a matching root element further on.
+  bool hidden[uint8_t(RootElement::Other)] = { false };
+
+  // Everything we see outside of a PI, doctype or comment must be one of
+  // those, or the documentElement itself.
+  while ((pos = aFindFirstOf(pos, end, '<', '<'))) {
+    const char* tag = pos++;
+    if (pos >= end)
+      return RootElement::None;
+
+    if (*pos != '?' && *pos != '!') {
+      RootElement root = MatchIndicator(tag, end);
+      if (root != RootElement::Other && hidden[uint8_t(root)])
+        return RootElement::Other;
+      return root;
+    }
+
+    // Skip to the '>' closing this node, remembering any indicator that we
+    // pass on the way, e.g. in <!-- <rdf:RDF .. > -->
+    while ((pos = aFindFirstOf(pos, end, '<', '>')) && *pos == '<') {
+      RootElement embedded = MatchIndicator(pos, end);
+      if (embedded != RootElement::Other)
+        hidden[uint8_t(embedded)] = true;
+      ++pos;
+    }
+    if (!pos)
+      return RootElement::None;
+
+    ++pos;
+  }
+  return RootElement::None;
+}
+
+} // namespace feedscan
+} // namespace browser
+} // namespace mozilla
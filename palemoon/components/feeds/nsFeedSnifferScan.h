@@ -0,0 +1,124 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsFeedSnifferScan_h__
+#define nsFeedSnifferScan_h__
+
+#include "mozilla/SSE.h"
+#include "mozilla/arm.h"
+#include <stdint.h>
+
+namespace mozilla {
+namespace browser {
+namespace feedscan {
+
+/**
+ * The kind of root element found at the start of a sniffed buffer.
+ */
+enum class RootElement : uint8_t
+{
+  // No root element was found, e.g. the prolog is unterminated or the buffer
+  // only contains processing instructions, doctypes and comments.
+  None,
+  RSS,    // <rss
+  Feed,   // <feed
+  RDF,    // <rdf:RDF
+  // A root element was found, but it is not one we are interested in, or one
+  // of our indicator substrings appeared earlier inside the prolog.
+  Other
+};
+
+/**
+ * Walk the prolog of |aData| once and classify its documentElement.
+ *
+ * The result is identical to checking "<rss", "<feed" and "<rdf:RDF" one
+ * after the other with a first-occurrence search followed by a walk of the
+ * prolog up to that occurrence, which is what nsFeedSniffer used to do.
+ * The namespace checks for RSS 1.0 are not part of this classification.
+ */
+RootElement ClassifyRootElement(const char* aData, uint32_t aLength);
+
+typedef const char* (*FindFirstOfKernel)(const char* aBegin, const char* aEnd,
+                                         char aChar1, char aChar2);
+
+/**
+ * ClassifyRootElement with a given FindFirstOf kernel, so that each kernel
+ * can be tested on its own.
+ */
+RootElement ClassifyRootElement(const char* aData, uint32_t aLength,
+                                FindFirstOfKernel aFindFirstOf);
+
+/**
+ * How the characters of a sniffed buffer are encoded.
+ */
+enum class Encoding : uint8_t
+{
+  // ASCII compatible, e.g. UTF-8 or ISO-8859-1; no narrowing needed.
+  Bytes,
+  UTF16LE,
+  UTF16BE,
+  UTF32LE,
+  UTF32BE
+};
+
+/**
+ * Detect the encoding of a buffer from its byte order mark or, lacking one,
+ * from the way its first character is laid out (see Appendix F of the XML
+ * specification).
+ *
+ * @param aBOMLength
+ *        Set to the number of bytes taken up by the byte order mark.
+ */
+Encoding DetectEncoding(const char* aData, uint32_t aLength,
+                        uint32_t* aBOMLength);
+
+/**
+ * Narrow UTF-16 or UTF-32 text to one byte per code unit. ASCII characters
+ * are kept and everything else becomes 0x80, which is all the sniffer needs
+ * to find markup. Trailing bytes that don't make up a whole code unit are
+ * dropped.
+ *
+ * @param aDest
+ *        Must have room for aLength / 2 bytes.
+ * @return the number of bytes written to |aDest|.
+ */
+uint32_t NarrowToASCII(Encoding aEncoding, const char* aData,
+                       uint32_t aLength, char* aDest);
+
+/**
+ * @return the first occurrence of either |aChar1| or |aChar2| within
+ *         [aBegin, aEnd), or nullptr if neither is found. Dispatches to the
+ *         best kernel available on the running CPU.
+ */
+const char* FindFirstOf(const char* aBegin, const char* aEnd,
+                        char aChar1, char aChar2);
+
+// Individual kernels, exposed so that they can be checked against each other.
+const char* FindFirstOf_Scalar(const char* aBegin, const char* aEnd,
+                               char aChar1, char aChar2);
+void NarrowUTF16_Scalar(const char* aData, uint32_t aUnits, bool aBigEndian,
+                        char* aDest);
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+void NarrowUTF16_SSE2(const char* aData, uint32_t aUnits, bool aBigEndian,
+                      char* aDest);
+const char* FindFirstOf_SSE2(const char* aBegin, const char* aEnd,
+                             char aChar1, char aChar2);
+#endif
+#ifdef MOZILLA_MAY_SUPPORT_AVX2
+const char* FindFirstOf_AVX2(const char* aBegin, const char* aEnd,
+                             char aChar1, char aChar2);
+#endif
+#ifdef BUILD_ARM_NEON
+void NarrowUTF16_NEON(const char* aData, uint32_t aUnits, bool aBigEndian,
+                      char* aDest);
+const char* FindFirstOf_NEON(const char* aBegin, const char* aEnd,
+                             char aChar1, char aChar2);
+#endif
+
+} // namespace feedscan
+} // namespace browser
+} // namespace mozilla
+
+#endif // nsFeedSnifferScan_h__
@@ -0,0 +1,39 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// This file is compiled with AVX2 code generation enabled.
+
+#include "nsFeedSnifferScan.h"
+
+#include "mozilla/MathAlgorithms.h"
+#include <immintrin.h>
+
+namespace mozilla {
+namespace browser {
+namespace feedscan {
+
+const char*
+FindFirstOf_AVX2(const char* aBegin, const char* aEnd,
+                 char aChar1, char aChar2)
+{
+  const __m256i needle1 = _mm256_set1_epi8(aChar1);
+  const __m256i needle2 = _mm256_set1_epi8(aChar2);
+
+  for (; aEnd - aBegin >= 32; aBegin += 32) {
+    __m256i chunk =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(aBegin));
+    __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, needle1),
+                                   _mm256_cmpeq_epi8(chunk, needle2));
+    uint32_t mask = uint32_t(_mm256_movemask_epi8(hits));
+    if (mask)
+      return aBegin + CountTrailingZeroes32(mask);
+  }
+
+  return FindFirstOf_Scalar(aBegin, aEnd, aChar1, aChar2);
+}
+
+} // namespace feedscan
+} // namespace browser
+} // namespace mozilla
@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// This file is compiled with NEON code generation enabled.
+
+#include "nsFeedSnifferScan.h"
+
+#include <arm_neon.h>
+
+namespace mozilla {
+namespace browser {
+namespace feedscan {
+
+void
+NarrowUTF16_NEON(const char* aData, uint32_t aUnits, bool aBigEndian,
+                 char* aDest)
+{
+  const uint16x8_t limit = vdupq_n_u16(0x80);
+
+  uint32_t i = 0;
+  for (; aUnits - i >= 8; i += 8) {
+    uint8x16_t bytes =
+      vld1q_u8(reinterpret_cast<const uint8_t*>(aData + i * 2));
+    if (aBigEndian)
+      bytes = vrev16q_u8(bytes);
+    uint16x8_t units = vminq_u16(vreinterpretq_u16_u8(bytes), limit);
+    vst1_u8(reinterpret_cast<uint8_t*>(aDest + i), vmovn_u16(units));
+  }
+
+  NarrowUTF16_Scalar(aData + i * 2, aUnits - i, aBigEndian, aDest + i);
+}
+
+const char*
+FindFirstOf_NEON(const char* aBegin, const char* aEnd,
+                 char aChar1, char aChar2)
+{
+  const uint8x16_t needle1 = vdupq_n_u8(uint8_t(aChar1));
+  const uint8x16_t needle2 = vdupq_n_u8(uint8_t(aChar2));
+
+  for (; aEnd - aBegin >= 16; aBegin += 16) {
+    uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(aBegin));
+    uint8x16_t hits = vorrq_u8(vceqq_u8(chunk, needle1),
+                               vceqq_u8(chunk, needle2));
+    // ARMv7 has no movemask, so fold the two halves together and only look
+    // at the individual bytes once we know that one of them matched.
+    uint64x2_t wide = vreinterpretq_u64_u8(hits);
+    if (vgetq_lane_u64(wide, 0) | vgetq_lane_u64(wide, 1))
+      return FindFirstOf_Scalar(aBegin, aBegin + 16, aChar1, aChar2);
+  }
+
+  return FindFirstOf_Scalar(aBegin, aEnd, aChar1, aChar2);
+}
+
+} // namespace feedscan
+} // namespace browser
+} // namespace mozilla
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// This file is compiled with SSE2 code generation enabled.
+
+#include "nsFeedSnifferScan.h"
+
+#include "mozilla/MathAlgorithms.h"
+#include <emmintrin.h>
+
+namespace mozilla {
+namespace browser {
+namespace feedscan {
+
+static inline __m128i
+NarrowUnits(__m128i aUnits, bool aBigEndian)
+{
+  if (aBigEndian) {
+    aUnits = _mm_or_si128(_mm_slli_epi16(aUnits, 8),
+                          _mm_srli_epi16(aUnits, 8));
+  }
+  // min(unit, 0x80), built from the saturating subtraction SSE2 does have.
+  const __m128i limit = _mm_set1_epi16(0x80);
+  return _mm_sub_epi16(aUnits, _mm_subs_epu16(aUnits, limit));
+}
+
+void
+NarrowUTF16_SSE2(const char* aData, uint32_t aUnits, bool aBigEndian,
+                 char* aDest)
+{
+  uint32_t i = 0;
+  for (; aUnits - i >= 16; i += 16) {
+    const __m128i* src = reinterpret_cast<const __m128i*>(aData + i * 2);
+    __m128i low = NarrowUnits(_mm_loadu_si128(src), aBigEndian);
+    __m128i high = NarrowUnits(_mm_loadu_si128(src + 1), aBigEndian);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(aDest + i),
+                     _mm_packus_epi16(low, high));
+  }
+
+  NarrowUTF16_Scalar(aData + i * 2, aUnits - i, aBigEndian, aDest + i);
+}
+
+const char*
+FindFirstOf_SSE2(const char* aBegin, const char* aEnd,
+                 char aChar1, char aChar2)
+{
+  const __m128i needle1 = _mm_set1_epi8(aChar1);
+  const __m128i needle2 = _mm_set1_epi8(aChar2);
+
+  for (; aEnd - aBegin >= 16; aBegin += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aBegin));
+    __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, needle1),
+                                _mm_cmpeq_epi8(chunk, needle2));
+    uint32_t mask = uint32_t(_mm_movemask_epi8(hits));
+    if (mask)
+      return aBegin + CountTrailingZeroes32(mask);
+  }
+
+  return FindFirstOf_Scalar(aBegin, aEnd, aChar1, aChar2);
+}
+
+} // namespace feedscan
+} // namespace browser
+} // namespace mozilla
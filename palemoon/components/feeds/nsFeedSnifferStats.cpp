@@ -0,0 +1,187 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsFeedSnifferStats.h"
+
+#include "nsCOMPtr.h"
+#include "nsThreadUtils.h"
+#include "nsServiceManagerUtils.h"
+#include "nsIObserverService.h"
+#include "mozilla/ArrayUtils.h"
+#include "mozilla/Sprintf.h"
+#include "mozilla/StaticPtr.h"
+#include <string.h>
+
+using namespace mozilla;
+
+#define STATS_REQUEST_TOPIC "feed-sniffer-stats-request"
+#define STATS_TOPIC "feed-sniffer-stats"
+
+static StaticRefPtr<nsFeedSnifferStats> sStats;
+static bool sShutdown = false;
+
+static const char* const kEarlyOutNames[] = {
+  "notGet",
+  "viewSource",
+  "feedContentType",
+  "feedHeader",
+  "contentType",
+  "cacheHit"
+};
+
+static_assert(ArrayLength(kEarlyOutNames) ==
+                nsFeedSnifferStats::eEarlyOutCount,
+              "Every early out needs a name");
+
+NS_IMPL_ISUPPORTS(nsFeedSnifferStats, nsIObserver)
+
+nsFeedSnifferStats::nsFeedSnifferStats()
+  : mSniffs(0)
+  , mPositives(0)
+  , mDecodes(0)
+  , mEncodedBytes(0)
+  , mDecodedBytes(0)
+{
+  memset(mEarlyOuts, 0, sizeof(mEarlyOuts));
+  memset(mSniffHistogram, 0, sizeof(mSniffHistogram));
+  memset(mDecodeHistogram, 0, sizeof(mDecodeHistogram));
+}
+
+nsFeedSnifferStats*
+nsFeedSnifferStats::Get()
+{
+  MOZ_ASSERT(NS_IsMainThread());
+
+  if (!sStats && !sShutdown) {
+    nsCOMPtr<nsIObserverService> obs =
+      do_GetService("@mozilla.org/observer-service;1");
+    if (!obs)
+      return nullptr;
+
+    sStats = new nsFeedSnifferStats();
+    obs->AddObserver(sStats, STATS_REQUEST_TOPIC, false);
+    obs->AddObserver(sStats, "xpcom-shutdown", false);
+  }
+  return sStats;
+}
+
+void
+nsFeedSnifferStats::Accumulate(uint32_t* aHistogram, TimeDuration aDuration)
+{
+  double us = aDuration.ToMicroseconds();
+  uint32_t bucket = 0;
+  while (bucket < kBucketCount - 1 && us >= 1.0) {
+    us /= 2.0;
+    ++bucket;
+  }
+  ++aHistogram[bucket];
+}
+
+void
+nsFeedSnifferStats::RecordSniff(TimeDuration aDuration, bool aIsFeed)
+{
+  ++mSniffs;
+  if (aIsFeed)
+    ++mPositives;
+  mSniffTime += aDuration;
+  Accumulate(mSniffHistogram, aDuration);
+}
+
+void
+nsFeedSnifferStats::RecordEarlyOut(EarlyOut aReason)
+{
+  MOZ_ASSERT(aReason < eEarlyOutCount);
+  ++mEarlyOuts[aReason];
+}
+
+void
+nsFeedSnifferStats::RecordDecode(TimeDuration aDuration,
+                                 uint32_t aEncodedBytes,
+                                 uint32_t aDecodedBytes)
+{
+  ++mDecodes;
+  mEncodedBytes += aEncodedBytes;
+  mDecodedBytes += aDecodedBytes;
+  Accumulate(mDecodeHistogram, aDuration);
+}
+
+static void
+AppendNumber(nsACString& aJSON, uint64_t aNumber)
+{
+  char buf[24];
+  SprintfLiteral(buf, "%llu", (unsigned long long)aNumber);
+  aJSON.Append(buf);
+}
+
+static void
+AppendHistogram(nsACString& aJSON, const uint32_t* aHistogram,
+                uint32_t aCount)
+{
+  aJSON.Append('[');
+  for (uint32_t i = 0; i < aCount; ++i) {
+    if (i)
+      aJSON.Append(',');
+    AppendNumber(aJSON, aHistogram[i]);
+  }
+  aJSON.Append(']');
+}
+
+void
+nsFeedSnifferStats::ToJSON(nsACString& aJSON)
+{
+  aJSON.AssignLiteral("{\"sniffs\":");
+  AppendNumber(aJSON, mSniffs);
+  aJSON.AppendLiteral(",\"positives\":");
+  AppendNumber(aJSON, mPositives);
+  aJSON.AppendLiteral(",\"totalTimeUs\":");
+  AppendNumber(aJSON, uint64_t(mSniffTime.ToMicroseconds()));
+
+  aJSON.AppendLiteral(",\"earlyOuts\":{");
+  for (uint32_t i = 0; i < eEarlyOutCount; ++i) {
+    if (i)
+      aJSON.Append(',');
+    aJSON.Append('"');
+    aJSON.Append(kEarlyOutNames[i]);
+    aJSON.AppendLiteral("\":");
+    AppendNumber(aJSON, mEarlyOuts[i]);
+  }
+  aJSON.Append('}');
+
+  aJSON.AppendLiteral(",\"decodes\":");
+  AppendNumber(aJSON, mDecodes);
+  aJSON.AppendLiteral(",\"encodedBytes\":");
+  AppendNumber(aJSON, mEncodedBytes);
+  aJSON.AppendLiteral(",\"inflatedBytes\":");
+  AppendNumber(aJSON, mDecodedBytes);
+
+  aJSON.AppendLiteral(",\"sniffLatencyUs\":");
+  AppendHistogram(aJSON, mSniffHistogram, kBucketCount);
+  aJSON.AppendLiteral(",\"decodeLatencyUs\":");
+  AppendHistogram(aJSON, mDecodeHistogram, kBucketCount);
+  aJSON.Append('}');
+}
+
+NS_IMETHODIMP
+nsFeedSnifferStats::Observe(nsISupports* aSubject, const char* aTopic,
+                            const char16_t* aData)
+{
+  nsCOMPtr<nsIObserverService> obs =
+    do_GetService("@mozilla.org/observer-service;1");
+  if (!obs)
+    return NS_ERROR_FAILURE;
+
+  if (!strcmp(aTopic, STATS_REQUEST_TOPIC)) {
+    nsAutoCString json;
+    ToJSON(json);
+    obs->NotifyObservers(nullptr, STATS_TOPIC,
+                         NS_ConvertUTF8toUTF16(json).get());
+  } else if (!strcmp(aTopic, "xpcom-shutdown")) {
+    obs->RemoveObserver(this, STATS_REQUEST_TOPIC);
+    obs->RemoveObserver(this, "xpcom-shutdown");
+    sShutdown = true;
+    sStats = nullptr;
+  }
+  return NS_OK;
+}
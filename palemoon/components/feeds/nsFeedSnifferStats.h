@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsFeedSnifferStats_h__
+#define nsFeedSnifferStats_h__
+
+#include "nsIObserver.h"
+#include "nsStringAPI.h"
+#include "mozilla/Attributes.h"
+#include "mozilla/TimeStamp.h"
+
+/**
+ * Counters and latency histograms for the feed sniffer, collected on live
+ * traffic.
+ *
+ * To read them, notify the "feed-sniffer-stats-request" topic through the
+ * observer service. The collector answers synchronously with a
+ * "feed-sniffer-stats" notification, with the numbers as a JSON string in
+ * its data argument.
+ *
+ * test/BenchFeedSnifferScan.cpp measures the scan itself over a corpus of
+ * files, outside of the browser.
+ */
+class nsFeedSnifferStats final : public nsIObserver
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIOBSERVER
+
+  // Reasons for returning before looking at the body.
+  enum EarlyOut {
+    eNotGet,           // Not a GET request, e.g. a POST.
+    eViewSource,       // view-source: load.
+    eFeedContentType,  // Served as RSS or Atom, trusted as is.
+    eFeedHeader,       // X-Moz-Is-Feed request header, trusted as is.
+    eContentType,      // Content-Type we don't sniff.
+    eCacheHit,         // Verdict reused from nsFeedSniffCache.
+    eEarlyOutCount
+  };
+
+  // Latency buckets are powers of two in microseconds: bucket 0 counts
+  // durations under 1us, bucket n durations in [2^(n-1), 2^n) us, and the
+  // last bucket everything above that.
+  static const uint32_t kBucketCount = 16;
+
+  /**
+   * @return the statistics collector, creating it on first use, or nullptr
+   *         once XPCOM is shutting down.
+   */
+  static nsFeedSnifferStats* Get();
+
+  void RecordSniff(mozilla::TimeDuration aDuration, bool aIsFeed);
+  void RecordEarlyOut(EarlyOut aReason);
+  void RecordDecode(mozilla::TimeDuration aDuration, uint32_t aEncodedBytes,
+                    uint32_t aDecodedBytes);
+
+  void ToJSON(nsACString& aJSON);
+
+  /**
+   * Times a sniff from construction to destruction, and records whether it
+   * ended up with a feed type.
+   */
+  class MOZ_RAII AutoTimer
+  {
+  public:
+    explicit AutoTimer(const nsACString& aSniffedType)
+      : mStats(nsFeedSnifferStats::Get())
+      , mSniffedType(aSniffedType)
+    {
+      if (mStats)
+        mStart = mozilla::TimeStamp::Now();
+    }
+
+    ~AutoTimer()
+    {
+      if (mStats) {
+        mStats->RecordSniff(mozilla::TimeStamp::Now() - mStart,
+                            !mSniffedType.IsEmpty());
+      }
+    }
+
+  private:
+    nsFeedSnifferStats* mStats;
+    const nsACString& mSniffedType;
+    mozilla::TimeStamp mStart;
+  };
+
+private:
+  nsFeedSnifferStats();
+  ~nsFeedSnifferStats() {}
+
+  static void Accumulate(uint32_t* aHistogram,
+                         mozilla::TimeDuration aDuration);
+
+  uint64_t mSniffs;
+  uint64_t mPositives;
+  uint64_t mEarlyOuts[eEarlyOutCount];
+  uint64_t mDecodes;
+  uint64_t mEncodedBytes;
+  uint64_t mDecodedBytes;
+  mozilla::TimeDuration mSniffTime;
+  uint32_t mSniffHistogram[kBucketCount];
+  uint32_t mDecodeHistogram[kBucketCount];
+};
+
+#endif // nsFeedSnifferStats_h__
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Times the part of nsFeedSniffer that looks at the body, over a corpus of
+ * files: the first kMaxSniffBytes of each are run through encoding
+ * detection, narrowing, the prolog scan and, for RSS 1.0, the namespace
+ * checks, with every kernel set the CPU supports.
+ *
+ *   BenchFeedSnifferScan [-n <iterations>] <file>...
+ *
+ * test/corpus has feeds, an HTML page and adversarial prologs to run it on.
+ * Content-Encoding is not covered: the files are sniffed as they are, since
+ * decoding goes through the XPCOM stream converters.
+ */
+
+#include "nsFeedSnifferScan.h"
+
+#include "mozilla/TimeStamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+using namespace mozilla;
+using namespace mozilla::browser::feedscan;
+
+// Keep in sync with nsFeedSniffer::kMaxSniffBytes.
+static const uint32_t kMaxSniffBytes = 512;
+
+#define NS_RDF "http://www.w3.org/1999/02/22-rdf-syntax-ns#"
+#define NS_RSS "http://purl.org/rss/1.0/"
+
+struct Kernel
+{
+  const char* mName;
+  FindFirstOfKernel mFindFirstOf;
+  void (*mNarrowUTF16)(const char*, uint32_t, bool, char*);
+};
+
+static bool
+Contains(const char* aData, uint32_t aLength, const char* aString)
+{
+  const char* end = aData + aLength;
+  return std::search(aData, end, aString, aString + strlen(aString)) != end;
+}
+
+/**
+ * Sniff |aData| the way nsFeedSniffer::GetMIMETypeFromContent does once it
+ * has the (decoded) body.
+ *
+ * @return whether it is a feed.
+ */
+static bool
+Sniff(const Kernel& aKernel, const char* aData, uint32_t aLength)
+{
+  char narrowed[kMaxSniffBytes];
+  uint32_t bomLength;
+  Encoding encoding = DetectEncoding(aData, aLength, &bomLength);
+  aData += bomLength;
+  aLength -= bomLength;
+  switch (encoding) {
+    case Encoding::UTF16LE:
+    case Encoding::UTF16BE:
+      aLength /= 2;
+      aKernel.mNarrowUTF16(aData, aLength, encoding == Encoding::UTF16BE,
+                           narrowed);
+      aData = narrowed;
+      break;
+    case Encoding::UTF32LE:
+    case Encoding::UTF32BE:
+      aLength = NarrowToASCII(encoding, aData, aLength, narrowed);
+      aData = narrowed;
+      break;
+    default:
+      break;
+  }
+
+  switch (ClassifyRootElement(aData, aLength, aKernel.mFindFirstOf)) {
+    case RootElement::RSS:
+    case RootElement::Feed:
+      return true;
+    case RootElement::RDF:
+      return Contains(aData, aLength, NS_RDF) &&
+             Contains(aData, aLength, NS_RSS);
+    default:
+      return false;
+  }
+}
+
+static bool
+ReadHead(const char* aPath, std::string& aData)
+{
+  FILE* file = fopen(aPath, "rb");
+  if (!file)
+    return false;
+  aData.resize(kMaxSniffBytes);
+  aData.resize(fread(&aData[0], 1, kMaxSniffBytes, file));
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+int
+main(int argc, char** argv)
+{
+  long iterations = 100000;
+  int first = 1;
+  if (argc > 2 && !strcmp(argv[1], "-n")) {
+    iterations = strtol(argv[2], nullptr, 10);
+    first = 3;
+  }
+  if (first >= argc || iterations <= 0) {
+    fprintf(stderr, "Usage: %s [-n <iterations>] <file>...\n", argv[0]);
+    return 1;
+  }
+
+  Kernel kernels[4] = { { "scalar", FindFirstOf_Scalar, NarrowUTF16_Scalar } };
+  size_t count = 1;
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2())
+    kernels[count++] = { "sse2", FindFirstOf_SSE2, NarrowUTF16_SSE2 };
+#endif
+#ifdef MOZILLA_MAY_SUPPORT_AVX2
+  // There is no AVX2 narrowing; nsFeedSniffer pairs it with SSE2's.
+  if (mozilla::supports_avx2())
+    kernels[count++] = { "avx2", FindFirstOf_AVX2, NarrowUTF16_SSE2 };
+#endif
+#ifdef BUILD_ARM_NEON
+  if (mozilla::supports_neon())
+    kernels[count++] = { "neon", FindFirstOf_NEON, NarrowUTF16_NEON };
+#endif
+
+  printf("%-24s %6s %-7s %-5s %10s\n",
+         "file", "bytes", "kernel", "feed", "ns/sniff");
+  int status = 0;
+  for (int i = first; i < argc; ++i) {
+    std::string data;
+    if (!ReadHead(argv[i], data)) {
+      fprintf(stderr, "Can't read %s\n", argv[i]);
+      status = 1;
+      continue;
+    }
+    const char* name = strrchr(argv[i], '/');
+    name = name ? name + 1 : argv[i];
+
+    for (size_t k = 0; k < count; ++k) {
+      // Accumulate the verdicts so that the calls can't be optimized away.
+      long feeds = 0;
+      TimeStamp start = TimeStamp::Now();
+      for (long n = 0; n < iterations; ++n)
+        feeds += Sniff(kernels[k], data.data(), data.size());
+      TimeDuration elapsed = TimeStamp::Now() - start;
+
+      printf("%-24s %6u %-7s %-5s %10.1f\n", name, unsigned(data.size()),
+             kernels[k].mName, feeds ? "yes" : "no",
+             elapsed.ToMicroseconds() * 1000.0 / iterations);
+    }
+  }
+  return status;
+}
@@ -0,0 +1,309 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Runs the feed sniffer's prolog scan over a fixed corpus, with every
+ * FindFirstOf and UTF-16 narrowing kernel the CPU supports, and checks the
+ * verdicts. Where the old three-search sniffer found no root element it
+ * answered Other rather than None; either means "not a feed".
+ */
+
+#include "nsFeedSnifferScan.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace mozilla::browser::feedscan;
+
+static int gFailures = 0;
+
+static void
+Fail(const char* aKernel, const char* aCase, const char* aMessage)
+{
+  ++gFailures;
+  fprintf(stderr, "TEST-UNEXPECTED-FAIL | TestFeedSnifferScan | %s | %s: %s\n",
+          aKernel, aCase, aMessage);
+}
+
+struct Kernel
+{
+  const char* mName;
+  FindFirstOfKernel mFindFirstOf;
+  void (*mNarrowUTF16)(const char*, uint32_t, bool, char*);
+};
+
+static const Kernel kScalar =
+  { "scalar", FindFirstOf_Scalar, NarrowUTF16_Scalar };
+
+struct Case
+{
+  const char* mName;
+  const char* mData;
+  RootElement mExpected;
+};
+
+// A comment long enough to take the vectorized kernels through several
+// full blocks before the root element.
+#define LONG_COMMENT "<!-- Lorem ipsum dolor sit amet, consectetur adipiscing " \
+                     "elit, sed do eiusmod tempor incididunt ut labore -->"
+
+static const Case kCorpus[] = {
+  { "rss", "<rss version=\"2.0\"><channel>", RootElement::RSS },
+  { "atom", "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            "<feed xmlns=\"http://www.w3.org/2005/Atom\">", RootElement::Feed },
+  { "rss 1.0", "<?xml version=\"1.0\"?>\n<rdf:RDF "
+               "xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">",
+    RootElement::RDF },
+  { "utf-8 bom", "\xEF\xBB\xBF<?xml version=\"1.0\"?><rss>", RootElement::RSS },
+  { "leading whitespace", " \r\n\t<feed>", RootElement::Feed },
+  { "comment", "<!-- generated --><rss>", RootElement::RSS },
+  { "long comment", LONG_COMMENT LONG_COMMENT "<feed>", RootElement::Feed },
+  { "other indicator in comment", "<!-- <feed> --><rss>", RootElement::RSS },
+  { "same indicator in comment", "<!-- <rss> --><rss>", RootElement::Other },
+  { "indicator in pi", "<?php echo '<feed>'; ?><feed>", RootElement::Other },
+  { "doctype", "<!DOCTYPE rss PUBLIC \"-//Netscape Communications//DTD RSS "
+               "0.91//EN\" \"http://my.netscape.com/publish/formats/"
+               "rss-0.91.dtd\">\n<rss version=\"0.91\">", RootElement::RSS },
+  { "doctype with internal subset",
+    "<!DOCTYPE rss [<!ENTITY nbsp \"&#160;\">]><rss>", RootElement::RSS },
+  { "stylesheet pi", "<?xml version=\"1.0\"?>"
+                     "<?xml-stylesheet type=\"text/xsl\" href=\"rss.xsl\"?>"
+                     "<rss>", RootElement::RSS },
+  { "html", "<!DOCTYPE html><html><head><title>rss</title>",
+    RootElement::Other },
+  { "rss below html root", "<html><rss>", RootElement::Other },
+  { "empty", "", RootElement::None },
+  { "text only", "rss feed", RootElement::None },
+  { "xml declaration only", "<?xml version=\"1.0\"?>", RootElement::None },
+  { "truncated xml declaration", "<?xml version=\"1.0\" enc",
+    RootElement::None },
+  { "truncated comment", "<!-- unterminated <rss>", RootElement::None },
+  { "truncated doctype", "<?xml version=\"1.0\"?><!DOCTYPE rss",
+    RootElement::None },
+  { "lone bracket", "<", RootElement::None },
+  { "truncated root name", "<?xml version=\"1.0\"?><rs", RootElement::Other },
+};
+
+static const char*
+Name(RootElement aRoot)
+{
+  switch (aRoot) {
+    case RootElement::None: return "None";
+    case RootElement::RSS: return "RSS";
+    case RootElement::Feed: return "Feed";
+    case RootElement::RDF: return "RDF";
+    case RootElement::Other: return "Other";
+  }
+  return "?";
+}
+
+static void
+CheckVerdict(const Kernel& aKernel, const Case& aCase, const char* aVariant,
+             RootElement aActual)
+{
+  if (aActual != aCase.mExpected) {
+    std::string message = std::string(aVariant) + " gave " + Name(aActual) +
+                          ", expected " + Name(aCase.mExpected);
+    Fail(aKernel.mName, aCase.mName, message.c_str());
+  }
+}
+
+static std::string
+Encode(const char* aASCII, Encoding aEncoding, bool aBOM)
+{
+  static const char kBOM16LE[] = "\xFF\xFE";
+  static const char kBOM16BE[] = "\xFE\xFF";
+  static const char kBOM32LE[] = "\xFF\xFE\0\0";
+  static const char kBOM32BE[] = "\0\0\xFE\xFF";
+
+  std::string out;
+  size_t width = 1;
+  bool bigEndian = false;
+  switch (aEncoding) {
+    case Encoding::UTF16LE:
+      width = 2;
+      if (aBOM) out.append(kBOM16LE, 2);
+      break;
+    case Encoding::UTF16BE:
+      width = 2;
+      bigEndian = true;
+      if (aBOM) out.append(kBOM16BE, 2);
+      break;
+    case Encoding::UTF32LE:
+      width = 4;
+      if (aBOM) out.append(kBOM32LE, 4);
+      break;
+    case Encoding::UTF32BE:
+      width = 4;
+      bigEndian = true;
+      if (aBOM) out.append(kBOM32BE, 4);
+      break;
+    default:
+      break;
+  }
+  for (const char* c = aASCII; *c; ++c) {
+    std::string unit(width, '\0');
+    unit[bigEndian ? width - 1 : 0] = *c;
+    out += unit;
+  }
+  return out;
+}
+
+/**
+ * Sniff |aBytes| the way nsFeedSniffer does: detect the encoding, skip the
+ * byte order mark, narrow if needed and classify.
+ */
+static RootElement
+Sniff(const Kernel& aKernel, const std::string& aBytes, Encoding* aDetected)
+{
+  uint32_t bomLength;
+  const char* data = aBytes.data();
+  uint32_t length = aBytes.size();
+  *aDetected = DetectEncoding(data, length, &bomLength);
+  data += bomLength;
+  length -= bomLength;
+
+  std::string narrowed(length / 2 + 1, '\0');
+  switch (*aDetected) {
+    case Encoding::UTF16LE:
+    case Encoding::UTF16BE:
+      length /= 2;
+      aKernel.mNarrowUTF16(data, length, *aDetected == Encoding::UTF16BE,
+                           &narrowed[0]);
+      data = narrowed.data();
+      break;
+    case Encoding::UTF32LE:
+    case Encoding::UTF32BE:
+      length = NarrowToASCII(*aDetected, data, length, &narrowed[0]);
+      data = narrowed.data();
+      break;
+    default:
+      break;
+  }
+  return ClassifyRootElement(data, length, aKernel.mFindFirstOf);
+}
+
+static void
+TestCorpus(const Kernel& aKernel)
+{
+  for (const Case& c : kCorpus) {
+    uint32_t length = strlen(c.mData);
+    CheckVerdict(aKernel, c, "bytes",
+                 ClassifyRootElement(c.mData, length, aKernel.mFindFirstOf));
+
+    // The same documents in UTF-16 and UTF-32, with and without a byte
+    // order mark. Without one, a document has to start with an ASCII
+    // character to be recognized, see DetectEncoding.
+    static const struct {
+      Encoding mEncoding;
+      const char* mName;
+    } kEncodings[] = {
+      { Encoding::UTF16LE, "utf-16le" },
+      { Encoding::UTF16BE, "utf-16be" },
+      { Encoding::UTF32LE, "utf-32le" },
+      { Encoding::UTF32BE, "utf-32be" },
+    };
+    if (!strncmp(c.mData, "\xEF\xBB\xBF", 3))
+      continue;
+    for (const auto& e : kEncodings) {
+      for (bool bom : { true, false }) {
+        if (!bom && length < 2)
+          continue;
+        std::string variant = std::string(e.mName) + (bom ? " bom" : "");
+        Encoding detected;
+        RootElement root = Sniff(aKernel, Encode(c.mData, e.mEncoding, bom),
+                                 &detected);
+        if (detected != e.mEncoding) {
+          Fail(aKernel.mName, c.mName,
+               (variant + " was not detected").c_str());
+          continue;
+        }
+        CheckVerdict(aKernel, c, variant.c_str(), root);
+      }
+    }
+  }
+}
+
+/**
+ * Compare a FindFirstOf kernel with the scalar one over every window of a
+ * buffer, so that each block size and alignment is covered.
+ */
+static void
+TestFindFirstOf(const Kernel& aKernel)
+{
+  char buffer[100];
+  for (size_t i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = 'a' + i % 26;
+  buffer[37] = '<';
+  buffer[70] = '>';
+  buffer[71] = '\x80';
+
+  for (size_t begin = 0; begin < sizeof(buffer); ++begin) {
+    for (size_t end = begin; end <= sizeof(buffer); ++end) {
+      const char* expected = FindFirstOf_Scalar(buffer + begin, buffer + end,
+                                                '<', '>');
+      const char* actual = aKernel.mFindFirstOf(buffer + begin, buffer + end,
+                                                '<', '>');
+      if (actual != expected) {
+        Fail(aKernel.mName, "FindFirstOf", "disagrees with the scalar kernel");
+        return;
+      }
+    }
+  }
+}
+
+static void
+TestNarrowUTF16(const Kernel& aKernel)
+{
+  // Units below, at and above the 0x80 cut-off, in both byte orders.
+  char source[2 * 70];
+  for (size_t i = 0; i < sizeof(source); ++i)
+    source[i] = char(i * 37 % 251);
+
+  for (bool bigEndian : { false, true }) {
+    for (uint32_t units = 0; units <= sizeof(source) / 2; ++units) {
+      char expected[70], actual[70];
+      NarrowUTF16_Scalar(source, units, bigEndian, expected);
+      aKernel.mNarrowUTF16(source, units, bigEndian, actual);
+      if (memcmp(expected, actual, units)) {
+        Fail(aKernel.mName, "NarrowUTF16", "disagrees with the scalar kernel");
+        return;
+      }
+    }
+  }
+}
+
+int
+main()
+{
+  Kernel kernels[4] = { kScalar };
+  size_t count = 1;
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2())
+    kernels[count++] = { "sse2", FindFirstOf_SSE2, NarrowUTF16_SSE2 };
+#endif
+#ifdef MOZILLA_MAY_SUPPORT_AVX2
+  // There is no AVX2 narrowing; nsFeedSniffer pairs it with SSE2's.
+  if (mozilla::supports_avx2())
+    kernels[count++] = { "avx2", FindFirstOf_AVX2, NarrowUTF16_SSE2 };
+#endif
+#ifdef BUILD_ARM_NEON
+  if (mozilla::supports_neon())
+    kernels[count++] = { "neon", FindFirstOf_NEON, NarrowUTF16_NEON };
+#endif
+
+  for (size_t i = 0; i < count; ++i) {
+    TestCorpus(kernels[i]);
+    if (i) {
+      TestFindFirstOf(kernels[i]);
+      TestNarrowUTF16(kernels[i]);
+    }
+    if (!gFailures)
+      printf("TEST-PASS | TestFeedSnifferScan | %s kernels\n", kernels[i].mName);
+  }
+
+  return gFailures ? 1 : 0;
+}
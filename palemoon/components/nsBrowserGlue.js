@@ -39,6 +39,7 @@ XPCOMUtils.defineLazyServiceGetter(this, "AlertsService",
   ["OS", "resource://gre/modules/osfile.jsm"],
   ["LoginManagerParent", "resource://gre/modules/LoginManagerParent.jsm"],
   ["FormValidationHandler", "resource:///modules/FormValidationHandler.jsm"],
+  ["MemoryTier", "resource:///modules/MemoryTier.jsm"],
   ["AutoCompletePopup", "resource:///modules/AutoCompletePopup.jsm"],
   ["DateTimePickerHelper", "resource://gre/modules/DateTimePickerHelper.jsm"],
   ["ShellService", "resource:///modules/ShellService.jsm"],
@@ -169,6 +170,10 @@ BrowserGlue.prototype = {
       case "sessionstore-windows-restored":
         this._onWindowsRestored();
         break;
+      case "shell-service-backend-created":
+        // Kept for the startup trace.
+        this._shellServiceTiming = JSON.parse(data);
+        break;
       case "browser:purge-session-history":
         // reset the console service's error buffer
         Services.console.logStringMessage(null); // clear the console (in case it's open)
@@ -337,6 +342,7 @@ BrowserGlue.prototype = {
     os.addObserver(this, "final-ui-startup", false);
     os.addObserver(this, "browser-delayed-startup-finished", false);
     os.addObserver(this, "sessionstore-windows-restored", false);
+    os.addObserver(this, "shell-service-backend-created", false);
     os.addObserver(this, "browser:purge-session-history", false);
     os.addObserver(this, "quit-application-requested", false);
     os.addObserver(this, "quit-application-granted", false);
@@ -370,6 +376,7 @@ BrowserGlue.prototype = {
     os.removeObserver(this, "prefservice:after-app-defaults");
     os.removeObserver(this, "final-ui-startup");
     os.removeObserver(this, "sessionstore-windows-restored");
+    os.removeObserver(this, "shell-service-backend-created");
     os.removeObserver(this, "browser:purge-session-history");
     os.removeObserver(this, "quit-application-requested");
     os.removeObserver(this, "quit-application-granted");
@@ -408,6 +415,8 @@ BrowserGlue.prototype = {
   // profile is available
   _onProfileAfterChange: function() {
     this._copyDefaultProfileFiles();
+    // Before any window opens, so that it sees the tier's defaults.
+    MemoryTier.init();
   },
   
   _promptForMasterPassword: function() {
@@ -640,11 +649,55 @@ BrowserGlue.prototype = {
 #endif
     FormValidationHandler.uninit();
     AutoCompletePopup.uninit();
+    MemoryTier.uninit();
     this._dispose();
   },
 
+  /**
+   * Adds the startup timeline milestones to the trace-event file written by
+   * the launcher when started with --startup-trace=<file>, along with when
+   * the shell service was created, if it was needed by then.
+   */
+  _appendStartupTrace: function() {
+    let env = Cc["@mozilla.org/process/environment;1"].
+              getService(Ci.nsIEnvironment);
+    let path = env.get("MOZ_STARTUP_TRACE");
+    if (!path) {
+      return;
+    }
+
+    let info = Services.startup.getStartupInfo();
+    let shellTiming = this._shellServiceTiming;
+    Task.spawn(function() {
+      let events = JSON.parse(yield OS.File.read(path, { encoding: "utf-8" }));
+      let pid = events.length ? events[0].pid : 0;
+      for (let name in info) {
+        if (!info[name]) {
+          continue;
+        }
+        events.push({ name: name, cat: "timeline", ph: "i", s: "p",
+                      ts: info[name].getTime() * 1000, pid: pid, tid: 0 });
+      }
+      if (shellTiming) {
+        events.push({ name: "ShellServiceProxy", cat: "shell", ph: "i",
+                      s: "p", ts: shellTiming.proxyCreated, pid: pid,
+                      tid: 0 });
+        events.push({ name: "ShellServiceBackend", cat: "shell", ph: "X",
+                      ts: shellTiming.start, dur: shellTiming.duration,
+                      pid: pid, tid: 0,
+                      args: { available: shellTiming.available } });
+      }
+      events.sort((a, b) => a.ts - b.ts);
+      let data = "[\n" + events.map(e => JSON.stringify(e)).join(",\n") + "\n]\n";
+      yield OS.File.writeAtomic(path, data, { encoding: "utf-8",
+                                             tmpPath: path + ".tmp" });
+    }).then(null, Cu.reportError);
+  },
+
   // All initial windows have opened.
   _onWindowsRestored: function() {
+    this._appendStartupTrace();
+
     // Show update notification, if needed.
     if (Services.prefs.prefHasUserValue("app.update.postupdate")) {
       this._showUpdateNotification();
@@ -695,58 +748,53 @@ BrowserGlue.prototype = {
         // never mind; suppose SessionStore is broken
       }
 
-      // startup check, check all assoc
-      let isDefault = false;
-      let isDefaultError = false;
-      try {
-        isDefault = ShellService.isDefaultBrowser(true, false);
-      } catch(ex) {
-        isDefaultError = true;
-      }
-
-      if (isDefault) {
-        let now = (Math.floor(Date.now() / 1000)).toString();
-        Services.prefs.setCharPref("browser.shell.mostRecentDateSetAsDefault", now);
-      }
+      // startup check, check all assoc. As before, failing to find out
+      // counts as not being the default browser.
+      ShellService.isDefaultBrowserAsync(true, false).catch(() => false).then(isDefault => {
+        if (isDefault) {
+          let now = (Math.floor(Date.now() / 1000)).toString();
+          Services.prefs.setCharPref("browser.shell.mostRecentDateSetAsDefault", now);
+        }
 
-      let willPrompt = shouldCheck && !isDefault && !willRecoverSession;
-
-      // Skip the "Set Default Browser" check during first-run or after the
-      // browser has been run a few times.
-      if (willPrompt) {
-        Services.tm.mainThread.dispatch(function() {
-          var win = this.getMostRecentBrowserWindow();
-          var brandBundle = win.document.getElementById("bundle_brand");
-          var shellBundle = win.document.getElementById("bundle_shell");
-
-          var brandShortName = brandBundle.getString("brandShortName");
-          var promptTitle = shellBundle.getString("setDefaultBrowserTitle");
-          var promptMessage = shellBundle.getFormattedString("setDefaultBrowserMessage",
-                                                             [brandShortName]);
-          var checkboxLabel = shellBundle.getFormattedString("setDefaultBrowserDontAsk",
-                                                             [brandShortName]);
-          var checkEveryTime = { value: shouldCheck };
-          var ps = Services.prompt;
-          var rv = ps.confirmEx(win, promptTitle, promptMessage,
-                                ps.STD_YES_NO_BUTTONS,
-                                null, null, null, checkboxLabel, checkEveryTime);
-          if (rv == 0) {
-            var claimAllTypes = true;
+        let willPrompt = shouldCheck && !isDefault && !willRecoverSession;
+
+        // Skip the "Set Default Browser" check during first-run or after the
+        // browser has been run a few times.
+        if (willPrompt) {
+          Services.tm.mainThread.dispatch(function() {
+            var win = this.getMostRecentBrowserWindow();
+            var brandBundle = win.document.getElementById("bundle_brand");
+            var shellBundle = win.document.getElementById("bundle_shell");
+
+            var brandShortName = brandBundle.getString("brandShortName");
+            var promptTitle = shellBundle.getString("setDefaultBrowserTitle");
+            var promptMessage = shellBundle.getFormattedString("setDefaultBrowserMessage",
+                                                               [brandShortName]);
+            var checkboxLabel = shellBundle.getFormattedString("setDefaultBrowserDontAsk",
+                                                               [brandShortName]);
+            var checkEveryTime = { value: shouldCheck };
+            var ps = Services.prompt;
+            var rv = ps.confirmEx(win, promptTitle, promptMessage,
+                                  ps.STD_YES_NO_BUTTONS,
+                                  null, null, null, checkboxLabel, checkEveryTime);
+            if (rv == 0) {
+              var claimAllTypes = true;
 #ifdef XP_WIN
-            try {
-              // In Windows 8+, the UI for selecting default protocol is much
-              // nicer than the UI for setting file type associations. So we
-              // only show the protocol association screen on Windows 8.
-              // Windows 8 is version 6.2.
-              let version = Services.sysinfo.getProperty("version");
-              claimAllTypes = (parseFloat(version) < 6.2);
-            } catch (ex) {}
+              try {
+                // In Windows 8+, the UI for selecting default protocol is much
+                // nicer than the UI for setting file type associations. So we
+                // only show the protocol association screen on Windows 8.
+                // Windows 8 is version 6.2.
+                let version = Services.sysinfo.getProperty("version");
+                claimAllTypes = (parseFloat(version) < 6.2);
+              } catch (ex) {}
 #endif
-            ShellService.setDefaultBrowser(claimAllTypes, false);
-          }
-          ShellService.shouldCheckDefaultBrowser = checkEveryTime.value;
-        }.bind(this), Ci.nsIThread.DISPATCH_NORMAL);
-      }
+              ShellService.setDefaultBrowser(claimAllTypes, false);
+            }
+            ShellService.shouldCheckDefaultBrowser = checkEveryTime.value;
+          }.bind(this), Ci.nsIThread.DISPATCH_NORMAL);
+        }
+      }).then(null, Cu.reportError);
     }
   },
 
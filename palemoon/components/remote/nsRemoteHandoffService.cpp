@@ -0,0 +1,271 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsRemoteHandoffService.h"
+
+#include "nsComponentManagerUtils.h"
+#include "nsServiceManagerUtils.h"
+#include "nsThreadUtils.h"
+#include "nsStringAPI.h"
+#include "nsTArray.h"
+#include "nsXPCOM.h"
+#include "nsIAsyncInputStream.h"
+#include "nsICommandLineRunner.h"
+#include "nsIFile.h"
+#include "nsIObserverService.h"
+#include "nsIOutputStream.h"
+#include "nsISocketTransport.h"
+#include "nsIXULRuntime.h"
+#include "mozilla/RefPtr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Must match the limit of the launcher.
+#define MAX_MESSAGE_SIZE (64 * 1024)
+
+// Seconds after which we drop a client that doesn't send its command line.
+#define READ_TIMEOUT 30
+
+/**
+ * One connection from a launcher: reads the whole message, runs it as a
+ * remote command line and sends back the one byte reply.
+ */
+class RemoteCommandLine final : public nsIInputStreamCallback
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIINPUTSTREAMCALLBACK
+
+  explicit RemoteCommandLine(nsISocketTransport* aTransport)
+    : mTransport(aTransport)
+  {
+  }
+
+  nsresult Start();
+
+private:
+  ~RemoteCommandLine() {}
+
+  bool Run();
+  void Finish(bool aHandled);
+
+  nsCOMPtr<nsISocketTransport> mTransport;
+  nsCOMPtr<nsIAsyncInputStream> mInput;
+  nsCString mMessage;
+};
+
+NS_IMPL_ISUPPORTS(RemoteCommandLine, nsIInputStreamCallback)
+
+nsresult
+RemoteCommandLine::Start()
+{
+  mTransport->SetTimeout(nsISocketTransport::TIMEOUT_READ_WRITE,
+                         READ_TIMEOUT);
+
+  nsCOMPtr<nsIInputStream> input;
+  nsresult rv = mTransport->OpenInputStream(0, 0, 0, getter_AddRefs(input));
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  mInput = do_QueryInterface(input, &rv);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  nsCOMPtr<nsIThread> mainThread = do_GetMainThread();
+  return mInput->AsyncWait(this, 0, 0, mainThread);
+}
+
+NS_IMETHODIMP
+RemoteCommandLine::OnInputStreamReady(nsIAsyncInputStream* aStream)
+{
+  char buffer[4096];
+  for (;;) {
+    uint32_t read;
+    nsresult rv = mInput->Read(buffer, sizeof(buffer), &read);
+    if (rv == NS_BASE_STREAM_WOULD_BLOCK) {
+      nsCOMPtr<nsIThread> mainThread = do_GetMainThread();
+      return mInput->AsyncWait(this, 0, 0, mainThread);
+    }
+    if (rv == NS_BASE_STREAM_CLOSED || (NS_SUCCEEDED(rv) && !read)) {
+      // The launcher is done writing.
+      break;
+    }
+    if (NS_FAILED(rv) || mMessage.Length() + read > MAX_MESSAGE_SIZE) {
+      mTransport->Close(NS_ERROR_ABORT);
+      return NS_OK;
+    }
+    mMessage.Append(buffer, read);
+  }
+
+  Finish(Run());
+  return NS_OK;
+}
+
+bool
+RemoteCommandLine::Run()
+{
+  // "1\0<working directory>\0<argument>\0...", see RemoteHandoff.h.
+  const char* data = mMessage.BeginReading();
+  const char* end = data + mMessage.Length();
+  if (data == end || end[-1] != '\0') {
+    return false;
+  }
+
+  nsTArray<const char*> fields;
+  for (const char* field = data; field < end; field += strlen(field) + 1) {
+    fields.AppendElement(field);
+  }
+  if (fields.Length() < 2 || strcmp(fields[0], "1")) {
+    return false;
+  }
+
+  nsCOMPtr<nsIFile> workingDir;
+  nsresult rv = NS_NewNativeLocalFile(nsDependentCString(fields[1]), true,
+                                      getter_AddRefs(workingDir));
+  if (NS_FAILED(rv)) {
+    return false;
+  }
+
+  nsCOMPtr<nsICommandLineRunner> cmdLine =
+    do_CreateInstance("@mozilla.org/toolkit/command-line;1");
+  if (!cmdLine) {
+    return false;
+  }
+
+  // Like argv, the command line skips its first element, which here is the
+  // working directory.
+  rv = cmdLine->Init(fields.Length() - 1,
+                     const_cast<char**>(fields.Elements() + 1),
+                     workingDir, nsICommandLine::STATE_REMOTE_AUTO);
+  if (NS_FAILED(rv)) {
+    return false;
+  }
+
+  // Same as the X remote service: only an unparseable command line is an
+  // error for the caller.
+  return cmdLine->Run() != NS_ERROR_ABORT;
+}
+
+void
+RemoteCommandLine::Finish(bool aHandled)
+{
+  nsCOMPtr<nsIOutputStream> output;
+  mTransport->OpenOutputStream(nsITransport::OPEN_UNBUFFERED, 0, 0,
+                               getter_AddRefs(output));
+  if (output) {
+    uint32_t written;
+    output->Write(aHandled ? "0" : "1", 1, &written);
+  }
+  mTransport->Close(NS_OK);
+}
+
+NS_IMPL_ISUPPORTS(nsRemoteHandoffService, nsIObserver, nsIServerSocketListener)
+
+NS_IMETHODIMP
+nsRemoteHandoffService::Observe(nsISupports* aSubject, const char* aTopic,
+                                const char16_t* aData)
+{
+  nsCOMPtr<nsIObserverService> obs =
+    do_GetService("@mozilla.org/observer-service;1");
+  if (!obs) {
+    return NS_ERROR_UNEXPECTED;
+  }
+
+  if (!strcmp(aTopic, "profile-after-change")) {
+    // Only the launcher of the main process tells us where to listen.
+    nsCOMPtr<nsIXULRuntime> runtime =
+      do_GetService("@mozilla.org/xre/app-info;1");
+    uint32_t processType = nsIXULRuntime::PROCESS_TYPE_DEFAULT;
+    if (runtime) {
+      runtime->GetProcessType(&processType);
+    }
+    if (processType == nsIXULRuntime::PROCESS_TYPE_DEFAULT &&
+        getenv("MOZ_REMOTE_SOCKET")) {
+      obs->AddObserver(this, "final-ui-startup", false);
+      obs->AddObserver(this, "profile-before-change", false);
+    }
+  } else if (!strcmp(aTopic, "final-ui-startup")) {
+    obs->RemoveObserver(this, "final-ui-startup");
+    Listen();
+  } else if (!strcmp(aTopic, "profile-before-change")) {
+    obs->RemoveObserver(this, "profile-before-change");
+    Stop();
+  }
+  return NS_OK;
+}
+
+void
+nsRemoteHandoffService::Listen()
+{
+  const char* path = getenv("MOZ_REMOTE_SOCKET");
+  if (!path || !*path) {
+    return;
+  }
+
+  nsCOMPtr<nsIFile> file;
+  nsresult rv = NS_NewNativeLocalFile(nsDependentCString(path), false,
+                                      getter_AddRefs(file));
+  // Processes we start must not think they own the socket.
+  unsetenv("MOZ_REMOTE_SOCKET");
+  if (NS_FAILED(rv)) {
+    return;
+  }
+
+  nsCOMPtr<nsIServerSocket> server =
+    do_CreateInstance("@mozilla.org/network/server-socket;1");
+  if (!server) {
+    return;
+  }
+
+  // This fails if another instance got there first.
+  rv = server->InitWithFilename(file, 0600, -1);
+  if (NS_FAILED(rv)) {
+    NS_WARNING("Couldn't listen for remote command lines");
+    return;
+  }
+
+  rv = server->AsyncListen(this);
+  if (NS_FAILED(rv)) {
+    server->Close();
+    file->Remove(false);
+    return;
+  }
+
+  mServer = server;
+  mSocketFile = file;
+}
+
+void
+nsRemoteHandoffService::Stop()
+{
+  if (!mServer) {
+    return;
+  }
+
+  mServer->Close();
+  mServer = nullptr;
+  // Later launches should start up normally rather than connect to a
+  // socket nobody listens on.
+  mSocketFile->Remove(false);
+  mSocketFile = nullptr;
+}
+
+NS_IMETHODIMP
+nsRemoteHandoffService::OnSocketAccepted(nsIServerSocket* aServer,
+                                         nsISocketTransport* aTransport)
+{
+  RefPtr<RemoteCommandLine> cmdLine = new RemoteCommandLine(aTransport);
+  nsresult rv = cmdLine->Start();
+  if (NS_FAILED(rv)) {
+    aTransport->Close(rv);
+  }
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsRemoteHandoffService::OnStopListening(nsIServerSocket* aServer,
+                                        nsresult aStatus)
+{
+  return NS_OK;
+}
@@ -0,0 +1,45 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsRemoteHandoffService_h__
+#define nsRemoteHandoffService_h__
+
+#include "nsCOMPtr.h"
+#include "nsIObserver.h"
+#include "nsIServerSocket.h"
+#include "mozilla/Attributes.h"
+
+class nsIFile;
+
+/**
+ * The receiving end of the launcher's remote handoff (see
+ * palemoon/app/RemoteHandoff.h).
+ *
+ * When the launcher found nobody listening, it leaves the socket path in
+ * MOZ_REMOTE_SOCKET. Once the UI is up we listen on that path and run every
+ * command line we receive as a remote one, just like the X remote service
+ * does, so a second launch doesn't have to start XPCOM to find us.
+ */
+class nsRemoteHandoffService final : public nsIObserver
+                                   , public nsIServerSocketListener
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIOBSERVER
+  NS_DECL_NSISERVERSOCKETLISTENER
+
+  nsRemoteHandoffService() {}
+
+private:
+  ~nsRemoteHandoffService() {}
+
+  void Listen();
+  void Stop();
+
+  nsCOMPtr<nsIServerSocket> mServer;
+  nsCOMPtr<nsIFile> mSocketFile;
+};
+
+#endif // nsRemoteHandoffService_h__
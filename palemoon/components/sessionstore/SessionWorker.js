@@ -0,0 +1,353 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * A worker dedicated to the session files, so that serializing the
+ * session, compressing it and the I/O all happen off the main thread.
+ * This is a private API, meant to be used only by _SessionFile.
+ *
+ * Messages are handled one at a time, in the order they were posted, so
+ * operations on the files never overlap.
+ */
+
+"use strict";
+
+importScripts("resource://gre/modules/osfile.jsm");
+importScripts("resource:///modules/sessionstore/SessionJournal.jsm");
+importScripts("resource:///modules/sessionstore/SessionIndex.jsm");
+
+var PromiseWorker = require("resource://gre/modules/workers/PromiseWorker.js");
+var Lz4 = require("resource://gre/modules/lz4.js");
+
+var File = OS.File;
+var Encoder = new TextEncoder();
+var Decoder = new TextDecoder();
+
+var worker = new PromiseWorker.AbstractWorker();
+worker.dispatch = function(method, args = []) {
+  return Agent[method](...args);
+};
+worker.postMessage = function(result, ...transfers) {
+  self.postMessage(result, ...transfers);
+};
+worker.close = function() {
+  self.close();
+};
+
+self.addEventListener("message", msg => worker.handleMessage(msg));
+
+// The first bytes of a mozLz4 file.
+const LZ4_MAGIC = "mozLz40\0";
+
+function hasLz4Magic(aBytes) {
+  if (aBytes.byteLength < LZ4_MAGIC.length) {
+    return false;
+  }
+  for (let i = 0; i < LZ4_MAGIC.length; i++) {
+    if (aBytes[i] != LZ4_MAGIC.charCodeAt(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+function isNoSuchFile(aEx) {
+  return aEx instanceof OS.File.Error && aEx.becauseNoSuchFile;
+}
+
+var Agent = {
+  // The paths of the session files. Compressed checkpoints and backups get
+  // names of their own, so that older builds and other tools find no
+  // session rather than one they take for corrupt JSON.
+  path: OS.Path.join(OS.Constants.Path.profileDir, "sessionstore.js"),
+  lz4Path: OS.Path.join(OS.Constants.Path.profileDir, "sessionstore.jsonlz4"),
+  backupPath: OS.Path.join(OS.Constants.Path.profileDir, "sessionstore.bak"),
+  lz4BackupPath: OS.Path.join(OS.Constants.Path.profileDir, "sessionstore.baklz4"),
+  journalPath: OS.Path.join(OS.Constants.Path.profileDir, "sessionstore.journal"),
+
+  /**
+   * The units of the state last written, as returned by
+   * SessionJournal.serialize, or null if the next write has to be a
+   * checkpoint.
+   */
+  _units: null,
+
+  // The checkpoint that the journal applies to.
+  _checkpointId: null,
+  _checkpointSize: 0,
+  _checkpointTime: 0,
+
+  // The number of bytes in the journal, 0 if we haven't started one since
+  // the last checkpoint.
+  _journalSize: 0,
+
+  /**
+   * Read a session file.
+   *
+   * @return its contents, decompressed if needed, or undefined if it
+   *         doesn't exist or can't be read.
+   */
+  _readText: function(aPath) {
+    try {
+      let bytes = File.read(aPath);
+      if (hasLz4Magic(bytes)) {
+        bytes = Lz4.decompressFileContent(bytes);
+      }
+      return Decoder.decode(bytes);
+    } catch (ex) {
+      if (!isNoSuchFile(ex)) {
+        console.error("Could not read session file: " + aPath, ex);
+      }
+      return undefined;
+    }
+  },
+
+  /**
+   * @return those of |aPaths| that exist, most recently modified first.
+   */
+  _existing: function(aPaths) {
+    let found = [];
+    for (let path of aPaths) {
+      try {
+        found.push({ path: path, time: File.stat(path).lastModificationDate.getTime() });
+      } catch (ex) {
+        if (!isNoSuchFile(ex)) {
+          console.error("Could not stat session file: " + path, ex);
+        }
+      }
+    }
+    found.sort((a, b) => b.time - a.time);
+    return found.map(f => f.path);
+  },
+
+  /**
+   * Read the most recent of |aPaths| that can be read. Both formats only
+   * exist side by side if we were interrupted while switching between
+   * them, in which case the newer file is the one that was just written.
+   *
+   * @return as _readText.
+   */
+  _readNewest: function(aPaths) {
+    for (let path of this._existing(aPaths)) {
+      let text = this._readText(path);
+      if (typeof text !== "undefined") {
+        return text;
+      }
+    }
+    return undefined;
+  },
+
+  _replayJournal: function(aText, aJournal) {
+    try {
+      return SessionJournal.replayText(aText, aJournal, SessionIndex);
+    } catch (ex) {
+      console.error("Could not replay the session journal: " + this.journalPath, ex);
+      return aText;
+    }
+  },
+
+  /**
+   * Read the session, from the backup if there is no checkpoint or it is
+   * corrupted.
+   *
+   * @return the session state as a string, empty if there is none.
+   */
+  read: function() {
+    let text = this._readNewest([this.path, this.lz4Path]);
+    if (typeof text === "undefined") {
+      text = this._readNewest([this.backupPath, this.lz4BackupPath]);
+    } else {
+      text = this._replayJournal(text, this._readText(this.journalPath));
+    }
+    return text || "";
+  },
+
+  /**
+   * Write the session.
+   *
+   * @param aData
+   *        The session state as a JSON string, or null to serialize |aState|.
+   * @param aState
+   *        The session state object, or null if only |aData| is known.
+   * @param aOptions
+   *        journal: whether changes may go into the journal;
+   *        checkpointInterval: the longest time between two checkpoints,
+   *        in milliseconds;
+   *        compress: whether to compress the checkpoint.
+   * @return an object with the time the request was received (|startTime|)
+   *         and the number of milliseconds spent serializing (|serializeMs|)
+   *         and writing (|writeMs|).
+   */
+  write: function(aData, aState, aOptions) {
+    let start = Date.now();
+    let units = null;
+    let id = aState ? SessionJournal.checkpointId(aState) : null;
+    if (id !== null && aOptions.journal) {
+      units = SessionJournal.serialize(aState);
+    }
+
+    let record = null;
+    let bytes = null;
+    let append = units && this._canAppend(aState, aOptions);
+    if (append) {
+      record = SessionJournal.diff(this._units, units);
+    } else {
+      bytes = Encoder.encode(aData !== null ? aData : SessionIndex.stringify(aState));
+    }
+    let serialized = Date.now();
+
+    try {
+      if (append) {
+        this._units = units;
+        if (record) {
+          this._appendToJournal(record);
+        }
+      } else {
+        this._writeCheckpoint(bytes, units, id, aOptions);
+      }
+    } catch (ex) {
+      // We no longer know what is on disk, start over.
+      this._units = null;
+      throw ex;
+    }
+
+    return {
+      startTime: start,
+      serializeMs: serialized - start,
+      writeMs: Date.now() - serialized
+    };
+  },
+
+  /**
+   * Whether the next write can go into the journal.
+   */
+  _canAppend: function(aState, aOptions) {
+    if (!this._units) {
+      return false;
+    }
+    // Leave a complete sessionstore.js behind when we shut down.
+    if (aState.session.state != "running") {
+      return false;
+    }
+    if (this._journalSize > this._checkpointSize * SessionJournal.MAX_RATIO) {
+      return false;
+    }
+    return Date.now() - this._checkpointTime < aOptions.checkpointInterval;
+  },
+
+  /**
+   * Write a checkpoint, and remove the journal of the previous one as well
+   * as a checkpoint left in the other format.
+   */
+  _writeCheckpoint: function(aBytes, aUnits, aId, aOptions) {
+    // Forget the previous checkpoint first, in case the write fails.
+    this._units = null;
+    let path = aOptions.compress ? this.lz4Path : this.path;
+    let options = {tmpPath: path + ".tmp"};
+    if (aOptions.compress) {
+      options.compression = "lz4";
+    }
+    File.writeAtomic(path, aBytes, options);
+    File.remove(aOptions.compress ? this.path : this.lz4Path, {ignoreAbsent: true});
+    File.remove(this.journalPath, {ignoreAbsent: true});
+
+    this._units = aUnits;
+    this._checkpointId = aId;
+    this._checkpointSize = aBytes.byteLength;
+    this._checkpointTime = Date.now();
+    this._journalSize = 0;
+  },
+
+  /**
+   * Append |aRecord| to the journal, starting a new one if this is the
+   * first record since the checkpoint.
+   */
+  _appendToJournal: function(aRecord) {
+    let first = this._journalSize == 0;
+    let bytes = Encoder.encode(first ?
+                               SessionJournal.header(this._checkpointId) + aRecord :
+                               aRecord);
+    let file = File.open(this.journalPath,
+                         first ? {truncate: true} : {write: true, append: true});
+    try {
+      file.write(bytes);
+    } finally {
+      file.close();
+    }
+    this._journalSize += bytes.byteLength;
+  },
+
+  /**
+   * Move the checkpoint to the backup of the same format, merging the
+   * journal into it.
+   *
+   * @param aOptions
+   *        compress: whether to compress a merged backup.
+   */
+  createBackupCopy: function(aOptions) {
+    // The next write starts from scratch.
+    this._units = null;
+
+    let checkpoints = this._existing([this.path, this.lz4Path]);
+
+    // The backup must not lose what is only in the journal.
+    let journal = this._readText(this.journalPath);
+    if (journal) {
+      let text = this._readNewest(checkpoints);
+      if (typeof text !== "undefined") {
+        this._replaceBackup(aOptions.compress, backupPath => {
+          let options = {tmpPath: backupPath + ".tmp"};
+          if (aOptions.compress) {
+            options.compression = "lz4";
+          }
+          File.writeAtomic(backupPath,
+                           Encoder.encode(this._replayJournal(text, journal)),
+                           options);
+        });
+        for (let path of checkpoints) {
+          File.remove(path, {ignoreAbsent: true});
+        }
+      }
+      File.remove(this.journalPath, {ignoreAbsent: true});
+      return;
+    }
+
+    if (!checkpoints.length) {
+      return;
+    }
+    this._replaceBackup(checkpoints[0] == this.lz4Path, backupPath => {
+      File.move(checkpoints[0], backupPath);
+    });
+    for (let path of checkpoints.slice(1)) {
+      File.remove(path, {ignoreAbsent: true});
+    }
+  },
+
+  /**
+   * Create a backup in one format with |aCreate|, then remove the backup in
+   * the other format, if any.
+   *
+   * @param aCompressed
+   *        Whether the backup is compressed.
+   * @param aCreate
+   *        Called with the path to create the backup at.
+   */
+  _replaceBackup: function(aCompressed, aCreate) {
+    aCreate(aCompressed ? this.lz4BackupPath : this.backupPath);
+    File.remove(aCompressed ? this.backupPath : this.lz4BackupPath,
+                {ignoreAbsent: true});
+  },
+
+  /**
+   * Remove all of the session files.
+   */
+  wipe: function() {
+    this._units = null;
+    File.remove(this.journalPath, {ignoreAbsent: true});
+    File.remove(this.path, {ignoreAbsent: true});
+    File.remove(this.lz4Path, {ignoreAbsent: true});
+    File.remove(this.backupPath, {ignoreAbsent: true});
+    File.remove(this.lz4BackupPath, {ignoreAbsent: true});
+  }
+};
@@ -2,6 +2,11 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+var {setTimeout} = Components.utils.import("resource://gre/modules/Timer.jsm", {});
+
+// Scrolling is reported at most this often, in milliseconds.
+const SCROLL_NOTIFY_DELAY_MS = 1000;
+
 function debug(msg) {
   Services.console.logStringMessage("SessionStoreContent: " + msg);
 }
@@ -13,9 +18,12 @@ function debug(msg) {
 var EventListener = {
 
   DOM_EVENTS: [
-    "pageshow", "change", "input"
+    "pageshow", "change", "input", "scroll"
   ],
 
+  // Whether a scroll is waiting to be reported.
+  _scrollPending: false,
+
   init: function () {
     this.DOM_EVENTS.forEach(e => addEventListener(e, this, true));
   },
@@ -30,6 +38,18 @@ var EventListener = {
       case "change":
         sendAsyncMessage("SessionStore:input");
         break;
+      case "scroll":
+        // Report a while after the first scroll instead of for every event.
+        // Scrolling after the report starts a new one, so the parent always
+        // hears of the last position.
+        if (!this._scrollPending) {
+          this._scrollPending = true;
+          setTimeout(() => {
+            this._scrollPending = false;
+            sendAsyncMessage("SessionStore:scroll");
+          }, SCROLL_NOTIFY_DELAY_MS);
+        }
+        break;
       default:
         debug("received unknown event '" + event.type + "'");
         break;
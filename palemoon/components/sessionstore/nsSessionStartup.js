@@ -42,6 +42,8 @@ Cu.import("resource://gre/modules/Promise.jsm");
 
 XPCOMUtils.defineLazyModuleGetter(this, "_SessionFile",
   "resource:///modules/sessionstore/_SessionFile.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "SessionIndex",
+  "resource:///modules/sessionstore/SessionIndex.jsm");
 
 const STATE_RUNNING_STR = "running";
 
@@ -103,10 +105,13 @@ SessionStartup.prototype = {
     try {
       this._initialized = true;
 
-      // Let observers modify the state before it is used
-      let supportsStateString = this._createSupportsString(aStateString);
-      Services.obs.notifyObservers(supportsStateString, "sessionstore-state-read", "");
-      aStateString = supportsStateString.data;
+      // Let observers modify the state before it is used. Copying the whole
+      // session into a string wrapper is not free, so only do it for them.
+      if (Services.obs.enumerateObservers("sessionstore-state-read").hasMoreElements()) {
+        let supportsStateString = this._createSupportsString(aStateString);
+        Services.obs.notifyObservers(supportsStateString, "sessionstore-state-read", "");
+        aStateString = supportsStateString.data;
+      }
 
       // No valid session found.
       if (!aStateString) {
@@ -120,7 +125,9 @@ SessionStartup.prototype = {
         aStateString = aStateString.slice(1, -1);
       let corruptFile = false;
       try {
-        this._initialState = JSON.parse(aStateString);
+        // Only what is needed to restore the first window is parsed now,
+        // the rest is parsed when it is first accessed.
+        this._initialState = SessionIndex.parse(aStateString);
       }
       catch (ex) {
         debug("The session file contained un-parse-able JSON: " + ex);
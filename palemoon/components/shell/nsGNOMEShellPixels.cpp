@@ -0,0 +1,70 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsGNOMEShellPixels.h"
+
+#include <string.h>
+
+namespace mozilla {
+namespace browser {
+namespace shellpixels {
+
+static inline uint8_t
+Unpremultiply(uint32_t aColor, uint32_t aAlpha)
+{
+  uint32_t value = (aColor * 255 + aAlpha / 2) / aAlpha;
+  return uint8_t(value > 255 ? 255 : value);
+}
+
+void
+ConvertRowToRGBA_Scalar(const uint8_t* aSrc, uint8_t* aDest,
+                        uint32_t aWidth, bool aOpaque)
+{
+  for (uint32_t i = 0; i < aWidth; ++i, aSrc += 4, aDest += 4) {
+    uint32_t pixel;
+    memcpy(&pixel, aSrc, sizeof(pixel));
+
+    uint32_t a = aOpaque ? 0xff : pixel >> 24;
+    uint32_t r = (pixel >> 16) & 0xff;
+    uint32_t g = (pixel >> 8) & 0xff;
+    uint32_t b = pixel & 0xff;
+    if (a == 0) {
+      aDest[0] = aDest[1] = aDest[2] = aDest[3] = 0;
+    } else if (a == 0xff) {
+      aDest[0] = r;
+      aDest[1] = g;
+      aDest[2] = b;
+      aDest[3] = 0xff;
+    } else {
+      aDest[0] = Unpremultiply(r, a);
+      aDest[1] = Unpremultiply(g, a);
+      aDest[2] = Unpremultiply(b, a);
+      aDest[3] = a;
+    }
+  }
+}
+
+void
+ConvertRowToRGBA(const uint8_t* aSrc, uint8_t* aDest, uint32_t aWidth,
+                 bool aOpaque)
+{
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2()) {
+    ConvertRowToRGBA_SSE2(aSrc, aDest, aWidth, aOpaque);
+    return;
+  }
+#endif
+#ifdef BUILD_ARM_NEON
+  if (mozilla::supports_neon()) {
+    ConvertRowToRGBA_NEON(aSrc, aDest, aWidth, aOpaque);
+    return;
+  }
+#endif
+  ConvertRowToRGBA_Scalar(aSrc, aDest, aWidth, aOpaque);
+}
+
+} // namespace shellpixels
+} // namespace browser
+} // namespace mozilla
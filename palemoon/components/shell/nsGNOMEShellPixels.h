@@ -0,0 +1,46 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsGNOMEShellPixels_h__
+#define nsGNOMEShellPixels_h__
+
+#include "mozilla/SSE.h"
+#include "mozilla/arm.h"
+#include <stdint.h>
+
+namespace mozilla {
+namespace browser {
+namespace shellpixels {
+
+/**
+ * Convert a row of native-endian, premultiplied ARGB32 pixels (what
+ * imgIContainer hands out as B8G8R8A8 or B8G8R8X8) to the non-premultiplied
+ * RGBA byte order that GdkPixbuf expects. Dispatches to the best kernel
+ * available on the running CPU.
+ *
+ * @param aOpaque
+ *        True if the source has no alpha channel (B8G8R8X8); the alpha
+ *        bytes are then ignored and written out as 0xff.
+ */
+void ConvertRowToRGBA(const uint8_t* aSrc, uint8_t* aDest, uint32_t aWidth,
+                      bool aOpaque);
+
+// Individual kernels, exposed so that they can be checked against each other.
+void ConvertRowToRGBA_Scalar(const uint8_t* aSrc, uint8_t* aDest,
+                             uint32_t aWidth, bool aOpaque);
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+void ConvertRowToRGBA_SSE2(const uint8_t* aSrc, uint8_t* aDest,
+                           uint32_t aWidth, bool aOpaque);
+#endif
+#ifdef BUILD_ARM_NEON
+void ConvertRowToRGBA_NEON(const uint8_t* aSrc, uint8_t* aDest,
+                           uint32_t aWidth, bool aOpaque);
+#endif
+
+} // namespace shellpixels
+} // namespace browser
+} // namespace mozilla
+
+#endif // nsGNOMEShellPixels_h__
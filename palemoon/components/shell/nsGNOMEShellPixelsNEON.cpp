@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// This file is compiled with NEON code generation enabled.
+
+#include "nsGNOMEShellPixels.h"
+
+#include "mozilla/EndianUtils.h"
+#include <arm_neon.h>
+
+namespace mozilla {
+namespace browser {
+namespace shellpixels {
+
+void
+ConvertRowToRGBA_NEON(const uint8_t* aSrc, uint8_t* aDest,
+                      uint32_t aWidth, bool aOpaque)
+{
+  uint32_t i = 0;
+#if MOZ_LITTLE_ENDIAN
+  const uint8x16_t opaqueAlpha = vdupq_n_u8(0xff);
+
+  // Opaque pixels only need their red and blue bytes swapped, sixteen at a
+  // time. Groups with any translucent pixel go through the scalar
+  // unpremultiply instead.
+  for (; aWidth - i >= 16; i += 16) {
+    uint8x16x4_t bgra = vld4q_u8(aSrc + i * 4);
+    if (aOpaque) {
+      bgra.val[3] = opaqueAlpha;
+    } else {
+      uint8x8_t alpha = vand_u8(vget_low_u8(bgra.val[3]),
+                                vget_high_u8(bgra.val[3]));
+      alpha = vpmin_u8(alpha, alpha);
+      alpha = vpmin_u8(alpha, alpha);
+      alpha = vpmin_u8(alpha, alpha);
+      if (vget_lane_u8(alpha, 0) != 0xff) {
+        ConvertRowToRGBA_Scalar(aSrc + i * 4, aDest + i * 4, 16, false);
+        continue;
+      }
+    }
+
+    uint8x16x4_t rgba;
+    rgba.val[0] = bgra.val[2];
+    rgba.val[1] = bgra.val[1];
+    rgba.val[2] = bgra.val[0];
+    rgba.val[3] = bgra.val[3];
+    vst4q_u8(aDest + i * 4, rgba);
+  }
+#endif
+
+  ConvertRowToRGBA_Scalar(aSrc + i * 4, aDest + i * 4, aWidth - i, aOpaque);
+}
+
+} // namespace shellpixels
+} // namespace browser
+} // namespace mozilla
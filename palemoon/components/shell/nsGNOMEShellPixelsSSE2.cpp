@@ -0,0 +1,56 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// This file is compiled with SSE2 code generation enabled.
+
+#include "nsGNOMEShellPixels.h"
+
+#include <emmintrin.h>
+
+namespace mozilla {
+namespace browser {
+namespace shellpixels {
+
+void
+ConvertRowToRGBA_SSE2(const uint8_t* aSrc, uint8_t* aDest,
+                      uint32_t aWidth, bool aOpaque)
+{
+  const __m128i alphaMask = _mm_set1_epi32(int32_t(0xff000000));
+  const __m128i greenAlphaMask = _mm_set1_epi32(int32_t(0xff00ff00));
+  const __m128i lowByte = _mm_set1_epi32(0xff);
+
+  // Opaque pixels only need their red and blue bytes swapped, four at a
+  // time. Groups with any translucent pixel go through the scalar
+  // unpremultiply instead.
+  uint32_t i = 0;
+  for (; aWidth - i >= 4; i += 4) {
+    __m128i pixels =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(aSrc + i * 4));
+    if (aOpaque) {
+      pixels = _mm_or_si128(pixels, alphaMask);
+    } else {
+      __m128i opaque =
+        _mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask);
+      if (_mm_movemask_epi8(opaque) != 0xffff) {
+        ConvertRowToRGBA_Scalar(aSrc + i * 4, aDest + i * 4, 4, false);
+        continue;
+      }
+    }
+
+    __m128i swapped =
+      _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask),
+                   _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16),
+                                              lowByte),
+                                _mm_slli_epi32(_mm_and_si128(pixels, lowByte),
+                                               16)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(aDest + i * 4), swapped);
+  }
+
+  ConvertRowToRGBA_Scalar(aSrc + i * 4, aDest + i * 4, aWidth - i, aOpaque);
+}
+
+} // namespace shellpixels
+} // namespace browser
+} // namespace mozilla
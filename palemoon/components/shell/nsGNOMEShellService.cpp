@@ -21,6 +21,10 @@
 #include "nsIStringBundle.h"
 #include "nsIOutputStream.h"
 #include "nsIProcess.h"
+#include "nsIEventTarget.h"
+#include "nsIObserverService.h"
+#include "nsThreadUtils.h"
+#include "nsProxyRelease.h"
 #include "nsServiceManagerUtils.h"
 #include "nsComponentManagerUtils.h"
 #include "nsIDOMHTMLImageElement.h"
@@ -28,9 +32,9 @@
 #include "imgIRequest.h"
 #include "imgIContainer.h"
 #include "mozilla/Sprintf.h"
-#if defined(MOZ_WIDGET_GTK)
-#include "nsIImageToPixbuf.h"
-#endif
+#include "mozilla/RefPtr.h"
+#include "mozilla/gfx/2D.h"
+#include "nsGNOMEShellPixels.h"
 #include "nsXULAppAPI.h"
 
 #include <glib.h>
@@ -38,10 +42,15 @@
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <errno.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace mozilla;
+using namespace mozilla::gfx;
 
 struct ProtocolAssociation
 {
@@ -147,12 +156,13 @@ nsGNOMEShellService::GetAppPathFromLauncher()
   return true;
 }
 
-bool
-nsGNOMEShellService::KeyMatchesAppName(const char *aKeyValue) const
+static bool
+KeyMatchesAppPath(const char *aKeyValue, const nsACString& aAppPath,
+                  bool aUseLocaleFilenames)
 {
 
   gchar *commandPath;
-  if (mUseLocaleFilenames) {
+  if (aUseLocaleFilenames) {
     gchar *nativePath = g_filename_from_utf8(aKeyValue, -1,
                                              nullptr, nullptr, nullptr);
     if (!nativePath) {
@@ -169,17 +179,19 @@ nsGNOMEShellService::KeyMatchesAppName(const char *aKeyValue) const
   if (!commandPath)
     return false;
 
-  bool matches = mAppPath.Equals(commandPath);
+  bool matches = aAppPath.Equals(commandPath);
   g_free(commandPath);
   return matches;
 }
 
-bool
-nsGNOMEShellService::CheckHandlerMatchesAppName(const nsACString &handler) const
+/* static */ bool
+nsGNOMEShellService::HandlerMatchesAppPath(const nsACString& aHandler,
+                                           const nsACString& aAppPath,
+                                           bool aUseLocaleFilenames)
 {
   gint argc;
   gchar **argv;
-  nsAutoCString command(handler);
+  nsAutoCString command(aHandler);
 
   // The string will be something of the form: [/path/to/]browser "%s"
   // We want to remove all of the parameters and get just the binary name.
@@ -189,19 +201,51 @@ nsGNOMEShellService::CheckHandlerMatchesAppName(const nsACString &handler) const
     g_strfreev(argv);
   }
 
-  if (!KeyMatchesAppName(command.get()))
+  if (!KeyMatchesAppPath(command.get(), aAppPath, aUseLocaleFilenames))
     return false; // the handler is set to another app
 
   return true;
 }
 
-NS_IMETHODIMP
-nsGNOMEShellService::IsDefaultBrowser(bool aStartupCheck,
-                                      bool aForAllTypes,
-                                      bool* aIsDefaultBrowser)
+bool
+nsGNOMEShellService::GetCachedMatch(const nsACString& aHandler,
+                                    bool* aMatches) const
 {
-  *aIsDefaultBrowser = false;
+  for (uint32_t i = 0; i < mHandlerMatches.Length(); ++i) {
+    if (mHandlerMatches[i].mHandler.Equals(aHandler)) {
+      *aMatches = mHandlerMatches[i].mMatches;
+      return true;
+    }
+  }
+  return false;
+}
 
+void
+nsGNOMEShellService::CacheMatch(const nsACString& aHandler, bool aMatches)
+{
+  bool cached;
+  if (GetCachedMatch(aHandler, &cached))
+    return;
+
+  HandlerMatch* match = mHandlerMatches.AppendElement();
+  match->mHandler = aHandler;
+  match->mMatches = aMatches;
+}
+
+bool
+nsGNOMEShellService::CheckHandlerMatchesAppName(const nsACString &handler)
+{
+  bool matches;
+  if (!GetCachedMatch(handler, &matches)) {
+    matches = HandlerMatchesAppPath(handler, mAppPath, mUseLocaleFilenames);
+    CacheMatch(handler, matches);
+  }
+  return matches;
+}
+
+bool
+nsGNOMEShellService::GetHandlers(nsTArray<nsCString>& aHandlers) const
+{
   nsCOMPtr<nsIGConfService> gconf = do_GetService(NS_GCONFSERVICE_CONTRACTID);
   nsCOMPtr<nsIGIOService> giovfs = do_GetService(NS_GIOSERVICE_CONTRACTID);
 
@@ -218,8 +262,9 @@ nsGNOMEShellService::IsDefaultBrowser(bool aStartupCheck,
       gconf->GetAppForProtocol(nsDependentCString(appProtocols[i].name),
                                &enabled, handler);
 
-      if (!CheckHandlerMatchesAppName(handler) || !enabled)
-        return NS_OK; // the handler is disabled or set to another app
+      if (!enabled)
+        return false; // the handler is disabled
+      aHandlers.AppendElement(handler);
     }
 
     if (giovfs) {
@@ -227,20 +272,125 @@ nsGNOMEShellService::IsDefaultBrowser(bool aStartupCheck,
       giovfs->GetAppForURIScheme(nsDependentCString(appProtocols[i].name),
                                  getter_AddRefs(gioApp));
       if (!gioApp)
-        return NS_OK;
+        return false;
 
       gioApp->GetCommand(handler);
-
-      if (!CheckHandlerMatchesAppName(handler))
-        return NS_OK; // the handler is set to another app
+      aHandlers.AppendElement(handler);
     }
   }
 
+  return true;
+}
+
+NS_IMETHODIMP
+nsGNOMEShellService::IsDefaultBrowser(bool aStartupCheck,
+                                      bool aForAllTypes,
+                                      bool* aIsDefaultBrowser)
+{
+  *aIsDefaultBrowser = false;
+
+  nsTArray<nsCString> handlers;
+  if (!GetHandlers(handlers))
+    return NS_OK;
+
+  for (uint32_t i = 0; i < handlers.Length(); ++i) {
+    if (!CheckHandlerMatchesAppName(handlers[i]))
+      return NS_OK; // the handler is set to another app
+  }
+
   *aIsDefaultBrowser = true;
 
   return NS_OK;
 }
 
+/**
+ * Resolves the handlers that nsGNOMEShellService hasn't seen before on the
+ * stream transport thread pool, then caches them and reports the result
+ * back on the main thread. The service and the callback are main thread
+ * only, so they are held through handles that release them there even if
+ * the check dies on the pool, e.g. when it can't get back at shutdown.
+ */
+class DefaultBrowserCheck final : public Runnable
+{
+public:
+  DefaultBrowserCheck(nsGNOMEShellService* aService,
+                      nsIGNOMEShellDefaultBrowserCallback* aCallback)
+    : mService(new nsMainThreadPtrHolder<nsGNOMEShellService>(aService))
+    , mCallback(new nsMainThreadPtrHolder<
+                  nsIGNOMEShellDefaultBrowserCallback>(aCallback))
+    , mAppPath(aService->mAppPath)
+    , mUseLocaleFilenames(aService->mUseLocaleFilenames)
+    , mIsDefault(false)
+  {
+  }
+
+  nsresult Start()
+  {
+    if (!mService->GetHandlers(mHandlers))
+      return NS_DispatchToMainThread(this);
+
+    // Only resolve what we don't know yet.
+    mIsDefault = true;
+    for (uint32_t i = 0; i < mHandlers.Length(); ++i) {
+      bool matches;
+      if (!mService->GetCachedMatch(mHandlers[i], &matches))
+        mUnresolved.AppendElement(mHandlers[i]);
+      else if (!matches)
+        mIsDefault = false;
+    }
+    if (mUnresolved.IsEmpty() || !mIsDefault)
+      return NS_DispatchToMainThread(this);
+
+    nsresult rv;
+    nsCOMPtr<nsIEventTarget> target =
+      do_GetService("@mozilla.org/network/stream-transport-service;1", &rv);
+    NS_ENSURE_SUCCESS(rv, rv);
+    return target->Dispatch(this, NS_DISPATCH_NORMAL);
+  }
+
+  NS_IMETHOD Run() override
+  {
+    if (!NS_IsMainThread()) {
+      for (uint32_t i = 0; i < mUnresolved.Length(); ++i) {
+        mMatches.AppendElement(
+          nsGNOMEShellService::HandlerMatchesAppPath(mUnresolved[i], mAppPath,
+                                                     mUseLocaleFilenames));
+      }
+      return NS_DispatchToMainThread(this);
+    }
+
+    for (uint32_t i = 0; i < mMatches.Length(); ++i) {
+      mService->CacheMatch(mUnresolved[i], mMatches[i]);
+      if (!mMatches[i])
+        mIsDefault = false;
+    }
+
+    return mCallback->OnResult(mIsDefault);
+  }
+
+private:
+  ~DefaultBrowserCheck() {}
+
+  nsMainThreadPtrHandle<nsGNOMEShellService> mService;
+  nsMainThreadPtrHandle<nsIGNOMEShellDefaultBrowserCallback> mCallback;
+  const nsCString mAppPath;
+  const bool mUseLocaleFilenames;
+  nsTArray<nsCString> mHandlers;
+  nsTArray<nsCString> mUnresolved;
+  nsTArray<bool> mMatches;
+  bool mIsDefault;
+};
+
+NS_IMETHODIMP
+nsGNOMEShellService::IsDefaultBrowserAsync(
+    nsIGNOMEShellDefaultBrowserCallback* aCallback)
+{
+  NS_ENSURE_ARG(aCallback);
+
+  RefPtr<DefaultBrowserCheck> check = new DefaultBrowserCheck(this, aCallback);
+  return check->Start();
+}
+
 NS_IMETHODIMP
 nsGNOMEShellService::SetDefaultBrowser(bool aClaimAllTypes,
                                        bool aForAllUsers)
@@ -323,41 +473,243 @@ nsGNOMEShellService::SetDefaultBrowser(bool aClaimAllTypes,
   return NS_OK;
 }
 
-NS_IMETHODIMP
-nsGNOMEShellService::GetCanSetDesktopBackground(bool* aResult)
+static bool
+CanSetDesktopBackground()
 {
   // setting desktop background is currently only supported
   // for Gnome or desktops using the same GSettings and GConf keys
   const char* gnomeSession = getenv("GNOME_DESKTOP_SESSION_ID");
-  if (gnomeSession) {
-    *aResult = true;
-  } else {
-    *aResult = false;
-  }
+  return gnomeSession != nullptr;
+}
 
+NS_IMETHODIMP
+nsGNOMEShellService::GetCanSetDesktopBackground(bool* aResult)
+{
+  *aResult = CanSetDesktopBackground();
   return NS_OK;
 }
 
-static nsresult
-WriteImage(const nsCString& aPath, imgIContainer* aImage)
+// Point the desktop settings at the wallpaper file in |aPath|.
+static void
+SetBackgroundSettings(const nsCString& aPath, const nsCString& aOptions)
 {
-#if !defined(MOZ_WIDGET_GTK)
-  return NS_ERROR_NOT_AVAILABLE;
-#else
-  nsCOMPtr<nsIImageToPixbuf> imgToPixbuf =
-    do_GetService("@mozilla.org/widget/image-to-gdk-pixbuf;1");
-  if (!imgToPixbuf)
-      return NS_ERROR_NOT_AVAILABLE;
+  // Try GSettings first. If we don't have GSettings or the right schema, fall back
+  // to using GConf instead. Note that if GSettings works ok, the changes get
+  // mirrored to GConf by the gsettings->gconf bridge in gnome-settings-daemon
+  nsCOMPtr<nsIGSettingsService> gsettings = 
+    do_GetService(NS_GSETTINGSSERVICE_CONTRACTID);
+  if (gsettings) {
+    nsCOMPtr<nsIGSettingsCollection> background_settings;
+    gsettings->GetCollectionForSchema(
+      NS_LITERAL_CSTRING(kDesktopBGSchema), getter_AddRefs(background_settings));
+    if (background_settings) {
+      gchar *file_uri = g_filename_to_uri(aPath.get(), nullptr, nullptr);
+      if (!file_uri)
+         return;
+
+      background_settings->SetString(NS_LITERAL_CSTRING(kDesktopOptionGSKey),
+                                     aOptions);
+
+      background_settings->SetString(NS_LITERAL_CSTRING(kDesktopImageGSKey),
+                                     nsDependentCString(file_uri));
+      g_free(file_uri);
+      background_settings->SetBoolean(NS_LITERAL_CSTRING(kDesktopDrawBGGSKey),
+                                      true);
+      return;
+    }
+  }
 
-  GdkPixbuf* pixbuf = imgToPixbuf->ConvertImageToPixbuf(aImage);
-  if (!pixbuf)
+  // if the file was written successfully, set it as the system wallpaper
+  nsCOMPtr<nsIGConfService> gconf = do_GetService(NS_GCONFSERVICE_CONTRACTID);
+
+  if (gconf) {
+    gconf->SetString(NS_LITERAL_CSTRING(kDesktopOptionsKey), aOptions);
+
+    // Set the image to an empty string first to force a refresh
+    // (since we could be writing a new image on top of an existing
+    // PaleMoon_wallpaper.png and nautilus doesn't monitor the file for changes)
+    gconf->SetString(NS_LITERAL_CSTRING(kDesktopImageKey),
+                     EmptyCString());
+
+    gconf->SetString(NS_LITERAL_CSTRING(kDesktopImageKey), aPath);
+    gconf->SetBool(NS_LITERAL_CSTRING(kDesktopDrawBGKey), true);
+  }
+}
+
+/**
+ * Writes an image out as the wallpaper file and then sets it as the desktop
+ * background.
+ *
+ * Converting a large image to RGBA and encoding it as PNG takes long enough
+ * to freeze the UI, so that part runs on the stream transport thread pool.
+ * The frame is mapped on the main thread before and unmapped after, so that
+ * its pixels stay put in between. The image is written to a temporary file
+ * of its own and renamed into place, and the desktop settings are only
+ * touched once that has succeeded; observers are notified with
+ * "shell:desktop-background-changed" either way.
+ */
+class WallpaperWriter final : public Runnable
+{
+public:
+  WallpaperWriter(DataSourceSurface* aSurface, const nsACString& aPath,
+                  const nsACString& aOptions)
+    : mSurface(aSurface)
+    , mOpaque(false)
+    , mMapped(false)
+    , mPath(aPath)
+    , mOptions(aOptions)
+    , mResult(NS_ERROR_NOT_INITIALIZED)
+  {
+  }
+
+  nsresult Start()
+  {
+    SurfaceFormat format = mSurface->GetFormat();
+    if (format != SurfaceFormat::B8G8R8A8 &&
+        format != SurfaceFormat::B8G8R8X8)
       return NS_ERROR_NOT_AVAILABLE;
+    mOpaque = format == SurfaceFormat::B8G8R8X8;
+    mSize = mSurface->GetSize();
 
-  gboolean res = gdk_pixbuf_save(pixbuf, aPath.get(), "png", nullptr, nullptr);
+    if (!mSurface->Map(DataSourceSurface::MapType::READ, &mMap))
+      return NS_ERROR_FAILURE;
+    mMapped = true;
 
-  g_object_unref(pixbuf);
-  return res ? NS_OK : NS_ERROR_FAILURE;
-#endif
+    nsresult rv;
+    nsCOMPtr<nsIEventTarget> target =
+      do_GetService("@mozilla.org/network/stream-transport-service;1", &rv);
+    if (NS_SUCCEEDED(rv))
+      rv = target->Dispatch(this, NS_DISPATCH_NORMAL);
+    if (NS_FAILED(rv)) {
+      mSurface->Unmap();
+      mMapped = false;
+    }
+    return rv;
+  }
+
+  NS_IMETHOD Run() override
+  {
+    if (!NS_IsMainThread()) {
+      mResult = Encode();
+      nsresult rv = NS_DispatchToMainThread(this);
+      if (NS_FAILED(rv)) {
+        // We are shutting down, so nobody will get to set the background;
+        // give the frame back here rather than on a main thread we won't
+        // see again.
+        mSurface->Unmap();
+        mMapped = false;
+        mSurface = nullptr;
+      }
+      return rv;
+    }
+
+    mSurface->Unmap();
+    mMapped = false;
+    mSurface = nullptr;
+
+    if (NS_SUCCEEDED(mResult))
+      SetBackgroundSettings(mPath, mOptions);
+
+    nsCOMPtr<nsIObserverService> obs =
+      do_GetService("@mozilla.org/observer-service;1");
+    if (obs)
+      obs->NotifyObservers(nullptr, "shell:desktop-background-changed",
+                           nullptr);
+    return NS_OK;
+  }
+
+private:
+  ~WallpaperWriter()
+  {
+    MOZ_ASSERT(!mMapped, "Should have been unmapped before going away");
+  }
+
+  nsresult Encode()
+  {
+    GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8,
+                                       mSize.width, mSize.height);
+    if (!pixbuf)
+      return NS_ERROR_OUT_OF_MEMORY;
+
+    guchar* dest = gdk_pixbuf_get_pixels(pixbuf);
+    int destStride = gdk_pixbuf_get_rowstride(pixbuf);
+    for (int32_t row = 0; row < mSize.height; ++row) {
+      browser::shellpixels::ConvertRowToRGBA(
+        mMap.mData + size_t(row) * mMap.mStride,
+        dest + size_t(row) * destStride, mSize.width, mOpaque);
+    }
+
+    // Every request gets its own temporary file, since two of them can be
+    // encoding at the same time.
+    nsAutoCString tempPath(mPath);
+    tempPath.AppendLiteral(".XXXXXX");
+    int fd = g_mkstemp(tempPath.BeginWriting());
+    if (fd < 0) {
+      g_object_unref(pixbuf);
+      return NS_ERROR_FAILURE;
+    }
+    fchmod(fd, 0644);
+
+    gboolean res = gdk_pixbuf_save_to_callback(pixbuf, WriteToFd, &fd, "png",
+                                               nullptr, nullptr);
+    g_object_unref(pixbuf);
+    if (close(fd))
+      res = FALSE;
+
+    if (!res || rename(tempPath.get(), mPath.get())) {
+      remove(tempPath.get());
+      return NS_ERROR_FAILURE;
+    }
+    return NS_OK;
+  }
+
+  static gboolean WriteToFd(const gchar* aBuf, gsize aCount, GError** aError,
+                            gpointer aFd)
+  {
+    int fd = *static_cast<int*>(aFd);
+    while (aCount) {
+      ssize_t written = write(fd, aBuf, aCount);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        g_set_error_literal(aError, G_FILE_ERROR,
+                            g_file_error_from_errno(errno),
+                            "Couldn't write the wallpaper");
+        return FALSE;
+      }
+      aBuf += written;
+      aCount -= written;
+    }
+    return TRUE;
+  }
+
+  RefPtr<DataSourceSurface> mSurface;
+  DataSourceSurface::MappedSurface mMap;
+  IntSize mSize;
+  bool mOpaque;
+  bool mMapped;
+  nsCString mPath;
+  nsCString mOptions;
+  nsresult mResult;
+};
+
+static nsresult
+WriteImage(const nsCString& aPath, const nsCString& aOptions,
+           imgIContainer* aImage)
+{
+  RefPtr<SourceSurface> surface =
+    aImage->GetFrame(imgIContainer::FRAME_CURRENT,
+                     imgIContainer::FLAG_SYNC_DECODE);
+  if (!surface)
+    return NS_ERROR_NOT_AVAILABLE;
+
+  RefPtr<DataSourceSurface> dataSurface = surface->GetDataSurface();
+  if (!dataSurface)
+    return NS_ERROR_NOT_AVAILABLE;
+
+  RefPtr<WallpaperWriter> writer =
+    new WallpaperWriter(dataSurface, aPath, aOptions);
+  return writer->Start();
 }
 
 NS_IMETHODIMP
@@ -413,53 +765,9 @@ nsGNOMEShellService::SetDesktopBackground(nsIDOMElement* aElement,
   filePath.Append(NS_ConvertUTF16toUTF8(brandName));
   filePath.AppendLiteral("_wallpaper.png");
 
-  // write the image to a file in the home dir
-  rv = WriteImage(filePath, container);
-  NS_ENSURE_SUCCESS(rv, rv);
-
-  // Try GSettings first. If we don't have GSettings or the right schema, fall back
-  // to using GConf instead. Note that if GSettings works ok, the changes get
-  // mirrored to GConf by the gsettings->gconf bridge in gnome-settings-daemon
-  nsCOMPtr<nsIGSettingsService> gsettings = 
-    do_GetService(NS_GSETTINGSSERVICE_CONTRACTID);
-  if (gsettings) {
-    nsCOMPtr<nsIGSettingsCollection> background_settings;
-    gsettings->GetCollectionForSchema(
-      NS_LITERAL_CSTRING(kDesktopBGSchema), getter_AddRefs(background_settings));
-    if (background_settings) {
-      gchar *file_uri = g_filename_to_uri(filePath.get(), nullptr, nullptr);
-      if (!file_uri)
-         return NS_ERROR_FAILURE;
-
-      background_settings->SetString(NS_LITERAL_CSTRING(kDesktopOptionGSKey),
-                                     options);
-
-      background_settings->SetString(NS_LITERAL_CSTRING(kDesktopImageGSKey),
-                                     nsDependentCString(file_uri));
-      g_free(file_uri);
-      background_settings->SetBoolean(NS_LITERAL_CSTRING(kDesktopDrawBGGSKey),
-                                      true);
-      return rv;
-    }
-  }
-
-  // if the file was written successfully, set it as the system wallpaper
-  nsCOMPtr<nsIGConfService> gconf = do_GetService(NS_GCONFSERVICE_CONTRACTID);
-
-  if (gconf) {
-    gconf->SetString(NS_LITERAL_CSTRING(kDesktopOptionsKey), options);
-
-    // Set the image to an empty string first to force a refresh
-    // (since we could be writing a new image on top of an existing
-    // PaleMoon_wallpaper.png and nautilus doesn't monitor the file for changes)
-    gconf->SetString(NS_LITERAL_CSTRING(kDesktopImageKey),
-                     EmptyCString());
-
-    gconf->SetString(NS_LITERAL_CSTRING(kDesktopImageKey), filePath);
-    gconf->SetBool(NS_LITERAL_CSTRING(kDesktopDrawBGKey), true);
-  }
-
-  return rv;
+  // write the image to a file in the home dir, and set it as the wallpaper
+  // once that is done
+  return WriteImage(filePath, options, container);
 }
 
 #define COLOR_16_TO_8_BIT(_c) ((_c) >> 8)
@@ -635,3 +943,60 @@ nsGNOMEShellService::GetDefaultFeedReader(nsIFile** _retval)
 {
   return NS_ERROR_NOT_IMPLEMENTED;
 }
+
+NS_IMPL_ISUPPORTS(nsGNOMEShellServiceProxy, nsIGNOMEShellService,
+                  nsIShellService)
+
+nsGNOMEShellServiceProxy::nsGNOMEShellServiceProxy()
+  : mBackendFailed(false)
+  , mCreated(PR_Now())
+{
+}
+
+nsGNOMEShellService*
+nsGNOMEShellServiceProxy::Backend()
+{
+  if (mBackend || mBackendFailed)
+    return mBackend;
+
+  PRTime start = PR_Now();
+  RefPtr<nsGNOMEShellService> backend = new nsGNOMEShellService();
+  nsresult rv = backend->Init();
+  if (NS_SUCCEEDED(rv))
+    mBackend = backend.forget();
+  else
+    mBackendFailed = true;
+  PRTime duration = PR_Now() - start;
+
+  nsCOMPtr<nsIObserverService> obs =
+    do_GetService("@mozilla.org/observer-service;1");
+  if (obs) {
+    char data[160];
+    SprintfLiteral(data,
+                   "{\"proxyCreated\":%lld,\"start\":%lld,"
+                   "\"duration\":%lld,\"available\":%s}",
+                   (long long)mCreated, (long long)start,
+                   (long long)duration, mBackend ? "true" : "false");
+    obs->NotifyObservers(static_cast<nsIGNOMEShellService*>(this),
+                         "shell-service-backend-created",
+                         NS_ConvertASCIItoUTF16(data).get());
+  }
+  return mBackend;
+}
+
+NS_IMETHODIMP
+nsGNOMEShellServiceProxy::GetCanSetDesktopBackground(bool* aResult)
+{
+  *aResult = CanSetDesktopBackground();
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsGNOMEShellServiceProxy::IsDefaultBrowserAsync(
+    nsIGNOMEShellDefaultBrowserCallback* aCallback)
+{
+  nsGNOMEShellService* backend = Backend();
+  if (!backend)
+    return NS_ERROR_NOT_AVAILABLE;
+  return backend->IsDefaultBrowserAsync(aCallback);
+}
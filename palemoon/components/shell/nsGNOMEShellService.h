@@ -8,7 +8,12 @@
 
 #include "nsIGNOMEShellService.h"
 #include "nsStringAPI.h"
+#include "nsTArray.h"
 #include "mozilla/Attributes.h"
+#include "mozilla/RefPtr.h"
+#include "prtime.h"
+
+class DefaultBrowserCheck;
 
 class nsGNOMEShellService final : public nsIGNOMEShellService
 {
@@ -24,8 +29,30 @@ public:
 private:
   ~nsGNOMEShellService() {}
 
-  bool KeyMatchesAppName(const char *aKeyValue) const;
-  bool CheckHandlerMatchesAppName(const nsACString& handler) const;
+  friend class DefaultBrowserCheck;
+
+  // Whether the command line |aHandler| runs the program at |aAppPath|.
+  // Searches PATH, so it may block; safe to call from any thread.
+  static bool HandlerMatchesAppPath(const nsACString& aHandler,
+                                    const nsACString& aAppPath,
+                                    bool aUseLocaleFilenames);
+  bool CheckHandlerMatchesAppName(const nsACString& handler);
+
+  // Collect the handler command lines of the essential protocols.
+  // @return false if one of them is disabled or has no handler at all.
+  bool GetHandlers(nsTArray<nsCString>& aHandlers) const;
+
+  // Results of HandlerMatchesAppPath, by handler command line. The results
+  // only depend on the command line, so a handler is looked up again only
+  // once it changes.
+  struct HandlerMatch
+  {
+    nsCString mHandler;
+    bool mMatches;
+  };
+  bool GetCachedMatch(const nsACString& aHandler, bool* aMatches) const;
+  void CacheMatch(const nsACString& aHandler, bool aMatches);
+  nsTArray<HandlerMatch> mHandlerMatches;
 
   bool GetAppPathFromLauncher();
   bool mUseLocaleFilenames;
@@ -33,4 +60,39 @@ private:
   bool mAppIsInPath;
 };
 
+/**
+ * What the shell service contract hands out. Creating nsGNOMEShellService
+ * looks up the GConf, GIO and GSettings services and resolves the path of
+ * our executable, which early callers that only want to know whether they
+ * can set the desktop background shouldn't pay for. The proxy answers that
+ * itself, and creates the real service on the first call that needs it.
+ *
+ * So that startup can be measured with the proxy in place, creating the
+ * real service notifies "shell-service-backend-created" with a JSON object:
+ *   {"proxyCreated": <PR_Now() when the proxy was created>,
+ *    "start": <PR_Now() when the real service was needed>,
+ *    "duration": <microseconds its creation and Init() took>,
+ *    "available": <whether Init() succeeded>}
+ * nsBrowserGlue adds it to the --startup-trace output.
+ */
+class nsGNOMEShellServiceProxy final : public nsIGNOMEShellService
+{
+public:
+  nsGNOMEShellServiceProxy();
+
+  NS_DECL_ISUPPORTS
+  NS_FORWARD_SAFE_NSISHELLSERVICE(Backend())
+  NS_DECL_NSIGNOMESHELLSERVICE
+
+private:
+  ~nsGNOMEShellServiceProxy() {}
+
+  // @return the real service, or nullptr if it isn't available.
+  nsGNOMEShellService* Backend();
+
+  RefPtr<nsGNOMEShellService> mBackend;
+  bool mBackendFailed;
+  PRTime mCreated;
+};
+
 #endif // nsgnomeshellservice_h____
@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+ * Checks every ConvertRowToRGBA kernel the CPU supports against the scalar
+ * one, over every window of a row of opaque, fully transparent and
+ * translucent pixels, so that each block size, alignment and fallback to
+ * the scalar unpremultiply is covered.
+ */
+
+#include "nsGNOMEShellPixels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace mozilla::browser::shellpixels;
+
+static int gFailures = 0;
+
+struct Kernel
+{
+  const char* mName;
+  void (*mConvert)(const uint8_t*, uint8_t*, uint32_t, bool);
+};
+
+// Long enough to hold a few of the widest (16 pixel) blocks.
+static const uint32_t kPixels = 80;
+
+/**
+ * Fill |aRow| with native-endian, premultiplied ARGB32 pixels: a run of
+ * opaque ones with a single translucent one in it, followed by a mix of
+ * transparent, translucent and opaque ones.
+ */
+static void
+FillRow(uint8_t* aRow)
+{
+  uint32_t seed = 12345;
+  for (uint32_t i = 0; i < kPixels; ++i) {
+    seed = seed * 1103515245 + 12345;
+    uint32_t alpha;
+    if (i < 40)
+      alpha = i == 29 ? 0x80 : 0xff;
+    else if (i % 3 == 0)
+      alpha = 0;
+    else if (i % 3 == 1)
+      alpha = 1 + (seed >> 8) % 254;
+    else
+      alpha = 0xff;
+
+    // Premultiplied color channels can't exceed alpha.
+    uint32_t pixel = alpha << 24;
+    for (int shift = 0; shift < 24; shift += 8) {
+      uint32_t channel = alpha ? (seed >> (shift + 4)) % (alpha + 1) : 0;
+      pixel |= channel << shift;
+    }
+    memcpy(aRow + i * 4, &pixel, sizeof(pixel));
+  }
+}
+
+static void
+TestKernel(const Kernel& aKernel, const uint8_t* aRow, bool aOpaque)
+{
+  uint8_t expected[kPixels * 4];
+  uint8_t actual[kPixels * 4];
+  for (uint32_t begin = 0; begin < kPixels; ++begin) {
+    for (uint32_t width = 0; begin + width <= kPixels; ++width) {
+      memset(expected, 0xcd, sizeof(expected));
+      memset(actual, 0xcd, sizeof(actual));
+      ConvertRowToRGBA_Scalar(aRow + begin * 4, expected + begin * 4, width,
+                              aOpaque);
+      aKernel.mConvert(aRow + begin * 4, actual + begin * 4, width, aOpaque);
+      if (memcmp(expected, actual, sizeof(actual))) {
+        ++gFailures;
+        fprintf(stderr, "TEST-UNEXPECTED-FAIL | TestGNOMEShellPixels | %s | "
+                "%s: %u pixels at %u disagree with the scalar kernel\n",
+                aKernel.mName, aOpaque ? "opaque" : "alpha", width, begin);
+        return;
+      }
+    }
+  }
+}
+
+int
+main()
+{
+  Kernel kernels[2];
+  size_t count = 0;
+#ifdef MOZILLA_MAY_SUPPORT_SSE2
+  if (mozilla::supports_sse2())
+    kernels[count++] = { "sse2", ConvertRowToRGBA_SSE2 };
+#endif
+#ifdef BUILD_ARM_NEON
+  if (mozilla::supports_neon())
+    kernels[count++] = { "neon", ConvertRowToRGBA_NEON };
+#endif
+
+  uint8_t row[kPixels * 4];
+  FillRow(row);
+
+  // Opaque sources leave their alpha bytes undefined, so the kernels have
+  // to ignore them.
+  uint8_t junkAlpha[kPixels * 4];
+  memcpy(junkAlpha, row, sizeof(row));
+  for (uint32_t i = 0; i < kPixels; ++i) {
+    uint32_t pixel;
+    memcpy(&pixel, junkAlpha + i * 4, sizeof(pixel));
+    pixel = (pixel & 0x00ffffff) | uint32_t(uint8_t(i * 37)) << 24;
+    memcpy(junkAlpha + i * 4, &pixel, sizeof(pixel));
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    int failures = gFailures;
+    TestKernel(kernels[i], row, false);
+    TestKernel(kernels[i], row, true);
+    TestKernel(kernels[i], junkAlpha, true);
+    if (gFailures == failures)
+      printf("TEST-PASS | TestGNOMEShellPixels | %s kernel\n",
+             kernels[i].mName);
+  }
+  if (!count)
+    printf("TEST-PASS | TestGNOMEShellPixels | no vector kernels to check\n");
+
+  return gFailures ? 1 : 0;
+}
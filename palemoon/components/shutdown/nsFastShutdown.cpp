@@ -0,0 +1,248 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsFastShutdown.h"
+
+#include "nsCOMPtr.h"
+#include "nsServiceManagerUtils.h"
+#include "nsIFile.h"
+#include "nsIObserverService.h"
+#include "nsIPrefBranch.h"
+#include "nsIProperties.h"
+#include "nsIXULRuntime.h"
+#include "mozilla/Sprintf.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The state of the profile directories when they were flushed, kept for
+// MOZ_FAST_SHUTDOWN_CHECK. This is plain C data, since it is compared after
+// XPCOM is gone.
+struct FileState
+{
+  char* mPath;
+  off_t mSize;
+  struct timespec mMTime;
+  bool mSeen;
+};
+
+static FileState* sFiles;
+static size_t sFileCount;
+static size_t sFileCapacity;
+static char* sDirs[2];
+static FILE* sReport;
+static uint32_t sLateWrites;
+
+static int
+CompareFileStates(const void* aA, const void* aB)
+{
+  return strcmp(static_cast<const FileState*>(aA)->mPath,
+                static_cast<const FileState*>(aB)->mPath);
+}
+
+static int
+CollectFile(const char* aPath, const struct stat* aStat, int aType,
+            struct FTW* aFTW)
+{
+  if (aType != FTW_F) {
+    return 0;
+  }
+
+  if (sFileCount == sFileCapacity) {
+    size_t capacity = sFileCapacity ? sFileCapacity * 2 : 256;
+    FileState* files =
+      static_cast<FileState*>(realloc(sFiles, capacity * sizeof(FileState)));
+    if (!files) {
+      return 1;
+    }
+    sFiles = files;
+    sFileCapacity = capacity;
+  }
+
+  FileState& file = sFiles[sFileCount++];
+  file.mPath = strdup(aPath);
+  file.mSize = aStat->st_size;
+  file.mMTime = aStat->st_mtim;
+  file.mSeen = false;
+  return 0;
+}
+
+static void
+ReportLateWrite(const char* aWhat, const char* aPath)
+{
+  ++sLateWrites;
+  fprintf(sReport, "%s %s\n", aWhat, aPath);
+}
+
+static int
+CheckFile(const char* aPath, const struct stat* aStat, int aType,
+          struct FTW* aFTW)
+{
+  if (aType != FTW_F) {
+    return 0;
+  }
+
+  FileState key;
+  key.mPath = const_cast<char*>(aPath);
+  FileState* file = static_cast<FileState*>(
+    bsearch(&key, sFiles, sFileCount, sizeof(FileState), CompareFileStates));
+  if (!file) {
+    ReportLateWrite("created", aPath);
+    return 0;
+  }
+
+  file->mSeen = true;
+  if (file->mSize != aStat->st_size ||
+      file->mMTime.tv_sec != aStat->st_mtim.tv_sec ||
+      file->mMTime.tv_nsec != aStat->st_mtim.tv_nsec) {
+    ReportLateWrite("modified", aPath);
+  }
+  return 0;
+}
+
+/**
+ * Runs at exit, or when browsercomps is unloaded, whichever comes first;
+ * either way after the XPCOM teardown.
+ */
+static void
+CheckLateWrites()
+{
+  for (char* dir : sDirs) {
+    if (dir) {
+      nftw(dir, CheckFile, 16, FTW_PHYS);
+    }
+  }
+  for (size_t i = 0; i < sFileCount; ++i) {
+    if (!sFiles[i].mSeen) {
+      ReportLateWrite("removed", sFiles[i].mPath);
+    }
+  }
+
+  fprintf(sReport, "%s %u\n", sLateWrites ? "FAILED" : "OK", sLateWrites);
+  fclose(sReport);
+}
+
+static bool
+GetDirectoryPath(nsIProperties* aDirService, const char* aKey,
+                 nsACString& aPath)
+{
+  nsCOMPtr<nsIFile> dir;
+  aDirService->Get(aKey, NS_GET_IID(nsIFile), getter_AddRefs(dir));
+  return dir && NS_SUCCEEDED(dir->GetNativePath(aPath));
+}
+
+NS_IMPL_ISUPPORTS(nsFastShutdown, nsIObserver)
+
+NS_IMETHODIMP
+nsFastShutdown::Observe(nsISupports* aSubject, const char* aTopic,
+                        const char16_t* aData)
+{
+  nsCOMPtr<nsIObserverService> obs =
+    do_GetService("@mozilla.org/observer-service;1");
+  if (!obs) {
+    return NS_ERROR_UNEXPECTED;
+  }
+
+  if (!strcmp(aTopic, "profile-after-change")) {
+    nsCOMPtr<nsIXULRuntime> runtime =
+      do_GetService("@mozilla.org/xre/app-info;1");
+    uint32_t processType = nsIXULRuntime::PROCESS_TYPE_DEFAULT;
+    if (runtime) {
+      runtime->GetProcessType(&processType);
+    }
+    if (processType != nsIXULRuntime::PROCESS_TYPE_DEFAULT) {
+      return NS_OK;
+    }
+
+    const char* reportPath = getenv("MOZ_FAST_SHUTDOWN_CHECK");
+    if (reportPath) {
+      mReportPath = reportPath;
+    }
+    bool enabled = false;
+    nsCOMPtr<nsIPrefBranch> prefs =
+      do_GetService("@mozilla.org/preferences-service;1");
+    if (prefs) {
+      prefs->GetBoolPref("browser.shutdown.fast", &enabled);
+    }
+    if (!enabled && mReportPath.IsEmpty()) {
+      return NS_OK;
+    }
+
+    nsCOMPtr<nsIProperties> dirService =
+      do_GetService("@mozilla.org/file/directory_service;1");
+    if (!dirService ||
+        !GetDirectoryPath(dirService, "ProfD", mProfileDir)) {
+      return NS_OK;
+    }
+    // The cache lives in the local profile directory.
+    GetDirectoryPath(dirService, "ProfLD", mLocalProfileDir);
+
+    obs->AddObserver(this, "quit-application", false);
+    obs->AddObserver(this, "xpcom-will-shutdown", false);
+  } else if (!strcmp(aTopic, "quit-application")) {
+    obs->RemoveObserver(this, "quit-application");
+    // The restarted instance is launched at the end of the regular shutdown.
+    mRestarting = aData && nsDependentString(aData).EqualsLiteral("restart");
+  } else if (!strcmp(aTopic, "xpcom-will-shutdown")) {
+    obs->RemoveObserver(this, "xpcom-will-shutdown");
+    if (mRestarting) {
+      return NS_OK;
+    }
+
+    if (mReportPath.IsEmpty()) {
+      // Doesn't return.
+      Exit();
+    }
+
+    // Open the report while we can still complain about it.
+    sReport = fopen(mReportPath.get(), "w");
+    if (!sReport) {
+      NS_WARNING("Can't open the MOZ_FAST_SHUTDOWN_CHECK report");
+      return NS_OK;
+    }
+
+    // Everything that was to be saved has been saved.
+    sDirs[0] = strdup(mProfileDir.get());
+    if (!mLocalProfileDir.IsEmpty() && !mLocalProfileDir.Equals(mProfileDir)) {
+      sDirs[1] = strdup(mLocalProfileDir.get());
+    }
+    for (char* dir : sDirs) {
+      if (dir) {
+        nftw(dir, CollectFile, 16, FTW_PHYS);
+      }
+    }
+    qsort(sFiles, sFileCount, sizeof(FileState), CompareFileStates);
+    atexit(CheckLateWrites);
+  }
+  return NS_OK;
+}
+
+void
+nsFastShutdown::Exit()
+{
+  // Remove our profile lock symlink, as the regular shutdown would, so that
+  // another process reusing our pid can't make the profile look in use.
+  nsAutoCString lock(mProfileDir);
+  lock.AppendLiteral("/lock");
+  char target[MAXPATHLEN];
+  ssize_t length = readlink(lock.get(), target, sizeof(target) - 1);
+  if (length > 0) {
+    target[length] = '\0';
+    char ours[32];
+    SprintfLiteral(ours, "+%d", int(getpid()));
+    const char* pid = strrchr(target, '+');
+    if (pid && !strcmp(pid, ours)) {
+      unlink(lock.get());
+    }
+  }
+
+  fflush(nullptr);
+  _exit(0);
+}
@@ -0,0 +1,47 @@
+/* -*- Mode: C++; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsFastShutdown_h__
+#define nsFastShutdown_h__
+
+#include "nsIObserver.h"
+#include "nsStringAPI.h"
+#include "mozilla/Attributes.h"
+
+/**
+ * Opt-in fast exit for Linux (browser.shutdown.fast).
+ *
+ * By the time xpcom-will-shutdown is sent, the profile has been torn down:
+ * sessionstore has written its final state, places has closed its database
+ * and the prefs have been saved. We then exit the process right away and
+ * skip the final cycle collection, the XPCOM teardown and the static
+ * destructors. Restarts always take the regular path.
+ *
+ * With MOZ_FAST_SHUTDOWN_CHECK set to a file outside the profile, we don't
+ * exit early but record the state of the profile directories at that
+ * point, let the regular shutdown run, and log every file written after it,
+ * which would have been lost by a fast exit, to that file. Its last line is
+ * either "OK 0" or "FAILED <number of late writes>".
+ */
+class nsFastShutdown final : public nsIObserver
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIOBSERVER
+
+  nsFastShutdown() : mRestarting(false) {}
+
+private:
+  ~nsFastShutdown() {}
+
+  void Exit();
+
+  nsCString mProfileDir;
+  nsCString mLocalProfileDir;
+  nsCString mReportPath;
+  bool mRestarting;
+};
+
+#endif // nsFastShutdown_h__